@@ -13,3 +13,5 @@ export const DRIFT_THRESHOLD = 1;
 export const DRIFT_LERP_FACTOR = 0.1;
 export const FIXED_VIEW_WIDTH = 1600;
 export const FIXED_VIEW_HEIGHT = 900;
+// How long an object that left a cell's frame lingers unless another cell reports it.
+export const CELL_LEAVE_GRACE_MS = 250;
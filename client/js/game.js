@@ -15,7 +15,8 @@ import { createPlayer } from "./player.js";
 import { createSnowball } from "./snowball.js";
 import { checkAlive } from "./updater.js";
 import { updateMovement, updateChargingIndicator } from "./input.js";
-import { sendPositionUpdate, handleServerMessage } from "./network.js";
+import { sendPositionUpdate, handleServerMessage, sendMessage } from "./network.js";
+import { WIRE_VERSION } from "./wire.js";
 
 export class GameScene extends Phaser.Scene {
     constructor() {
@@ -65,13 +66,17 @@ export class GameScene extends Phaser.Scene {
         this.snowballs = this.physics.add.group();
 
         this.socket = new WebSocket("ws://localhost:12345");
+        this.socket.binaryType = "arraybuffer";
+        // Open the game with ?protocol=json to keep readable JSON traffic.
+        const useJson = new URLSearchParams(window.location.search).get("protocol") === "json";
         this.socket.onopen = () => {
             console.log("Connected to server");
-            // Send join message.
+            // Send join message, asking for the binary protocol.
             this.socket.send(JSON.stringify({
                 type: "join",
                 id: this.player.id,
-                position: { x: this.player.container.x, y: this.player.container.y }
+                position: { x: this.player.container.x, y: this.player.container.y },
+                ...(useJson ? {} : { protocol: WIRE_VERSION })
             }));
             // Start periodic ping every 5 seconds.
             this.pingInterval = setInterval(() => {
@@ -79,7 +84,7 @@ export class GameScene extends Phaser.Scene {
                     type: "ping",
                     clientTime: Date.now()
                 };
-                this.socket.send(JSON.stringify(pingMsg));
+                sendMessage(this, pingMsg);
             }, 5000);
         };
         this.socket.onmessage = handleServerMessage.bind(this);
@@ -138,7 +143,7 @@ export class GameScene extends Phaser.Scene {
 
         // Inform the server about the new charging snowball.
         if (this.socket.readyState === WebSocket.OPEN) {
-            this.socket.send(JSON.stringify({
+            sendMessage(this, {
                 type: "movement",
                 objectType: "snowball",
                 id: snowballId,
@@ -148,7 +153,7 @@ export class GameScene extends Phaser.Scene {
                 },
                 size: INITIAL_SNOWBALL_RADIUS,
                 charging: true
-            }));
+            });
         }
     }
 
@@ -182,7 +187,7 @@ export class GameScene extends Phaser.Scene {
 
         // Send the updated snowball data to the server including damage
         if (this.socket.readyState === WebSocket.OPEN) {
-            this.socket.send(JSON.stringify({
+            sendMessage(this, {
                 type: "movement",
                 objectType: "snowball",
                 id: snowballId,
@@ -193,7 +198,7 @@ export class GameScene extends Phaser.Scene {
                 charging: false,
                 timeEmission: Date.now() + (this.serverTimeOffset || 0),
                 lifeLength: 3000
-            }));
+            });
         }
 
         this.isCharging = false;
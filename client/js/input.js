@@ -4,6 +4,7 @@ import {
     CHARGE_MAX_TIME,
     MAX_SNOWBALL_RADIUS
 } from "./constants.js";
+import { sendMessage } from "./network.js";
 
 export function anyKeyIsDown(keys) {
     return keys.some(key => key.isDown);
@@ -79,14 +80,14 @@ export function updateChargingIndicator(scene, player, chargeStartTime, isChargi
 
         // Send update to the server so others see the charging state.
         if (scene.socket.readyState === WebSocket.OPEN) {
-            scene.socket.send(JSON.stringify({
+            sendMessage(scene, {
                 type: "movement",
                 objectType: "snowball",
                 id: player.snowball.id, // Use the same id throughout.
                 position: { x: newX, y: newY },
                 size: newRadius,
                 charging: true
-            }));
+            });
         }
     }
 }
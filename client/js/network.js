@@ -1,4 +1,28 @@
-import { updateGameObject } from "./updater.js";
+import { updateGameObject, expireObject } from "./updater.js";
+import { CELL_LEAVE_GRACE_MS } from "./constants.js";
+import { WIRE_VERSION, encodePing, encodePlayerMove, encodeSnowballMove, decodeFrame } from "./wire.js";
+
+// Sends a message in the protocol agreed at join. Messages without a
+// binary encoding (join, respawn) always go as JSON.
+export function sendMessage(scene, msg) {
+    const socket = scene.socket;
+    if (socket.readyState !== WebSocket.OPEN) return;
+    if (scene.wireProtocol === WIRE_VERSION) {
+        if (msg.type === "ping") {
+            socket.send(encodePing(msg.clientTime));
+            return;
+        }
+        if (msg.type === "movement" && msg.objectType === "player") {
+            socket.send(encodePlayerMove(msg.position.x, msg.position.y));
+            return;
+        }
+        if (msg.type === "movement" && msg.objectType === "snowball") {
+            socket.send(encodeSnowballMove(msg));
+            return;
+        }
+    }
+    socket.send(JSON.stringify(msg));
+}
 
 export function sendPositionUpdate(scene, socket, player, velocityX, velocityY) {
     if (!scene.lastSentPosition) {
@@ -17,15 +41,47 @@ export function sendPositionUpdate(scene, socket, player, velocityX, velocityY)
             velocity: { x: velocityX, y: velocityY },
             t: Date.now() + (scene.serverTimeOffset || 0),
         };
-        socket.send(JSON.stringify(updateMsg));
+        sendMessage(scene, updateMsg);
         scene.lastSentPosition = { x: player.container.x, y: player.container.y };
     }
 }
 
 export function handleServerMessage(event) {
-    const data = JSON.parse(event.data);
+    if (event.data instanceof ArrayBuffer) {
+        const serverNow = Date.now() + (this.serverTimeOffset || 0);
+        this.wireNames ??= new Map();
+        for (const data of decodeFrame(event.data, this.wireNames, serverNow)) {
+            handleMessage(this, data);
+        }
+        return;
+    }
+    handleMessage(this, JSON.parse(event.data));
+}
+
+function handleMessage(scene, data) {
     // console.log("Received: ", data);
     switch (data.messageType) {
+        case "welcome":
+            // The server confirmed (or declined) the binary protocol.
+            scene.wireProtocol = data.protocol;
+            return;
+        case "cell": {
+            // A cell's frame lists everything in it. Objects its last frame
+            // listed that are missing moved on: unless another cell reports
+            // them (which resets expireDate), they left the view.
+            scene.cellObjects ??= new Map();
+            const present = new Set(data.ids);
+            for (const id of scene.cellObjects.get(data.key) ?? []) {
+                if (!present.has(id)) expireObject(scene, id, data.serverNow + CELL_LEAVE_GRACE_MS);
+            }
+            if (data.ids.length) scene.cellObjects.set(data.key, data.ids);
+            else scene.cellObjects.delete(data.key);
+            return;
+        }
+        case "snapshot":
+            // Everything in view this tick, each entry a "movement" message.
+            data.objects.forEach(object => updateGameObject(scene, object));
+            return;
         case "pong": {
             // Calculate round-trip time (RTT) and offset.
             const T3 = Date.now();
@@ -34,25 +90,25 @@ export function handleServerMessage(event) {
             const rtt = T3 - T1;
             const offset = T2 - (T1 + rtt / 2);
             // Store the offset in the scene.
-            this.serverTimeOffset = offset;
+            scene.serverTimeOffset = offset;
             console.log("Calculated server time offset:", offset);
             return;
         }
         case "movement":
             break;
         case "hit":
-            handleHit(this, data);
+            handleHit(scene, data);
             break;
         case "death":
-            handleDeath(this, data);
+            handleDeath(scene, data);
             break;
         case "respawn":
-            handleRespawn(this, data);
+            handleRespawn(scene, data);
             break;
         default:
             console.warn("Unknown message type:", data.type);
     }
-    updateGameObject(this, data);
+    updateGameObject(scene, data);
 }
 
 function handleHit(scene, data) {
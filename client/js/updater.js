@@ -18,6 +18,14 @@ export function checkAlive(scene) {
     });
 }
 
+// Makes a remote object expire by expireDate at the latest; the local
+// player is left alone.
+export function expireObject(scene, id, expireDate) {
+    if (scene.player && id === scene.player.id) return;
+    const target = scene.players[id] ?? scene.snowballs.getChildren().find(s => s.id === id);
+    if (target) target.expireDate = Math.min(target.expireDate ?? Infinity, expireDate);
+}
+
 export function updateGameObject(scene, data) {
     // data: { objectType, id, position, velocity, size, charging, newHealth, isDead, ... }
     switch (data.objectType) {
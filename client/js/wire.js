@@ -0,0 +1,197 @@
+// Binary wire protocol; see server/src/wire.h for the frame layout.
+// The client asks for it in its "join" message and switches over once the
+// server's "welcome" confirms the version.
+
+export const WIRE_VERSION = 2;
+
+const Record = {
+    NAME: 1,
+    STATE: 2,
+    PONG: 3,
+    PING: 4,
+    PLAYER_MOVE: 5,
+    SNOWBALL_MOVE: 6,
+    CELL: 7,
+};
+
+const MESSAGE_TYPES = ["movement", "hit"];
+const OBJECT_TYPES = ["unknown", "player", "snowball"];
+const WIRE_CHARGING = 1 << 2;
+const WIRE_DEAD = 1 << 3;
+const WIRE_NO_EXPIRY = 0xffffffff;
+
+const textEncoder = new TextEncoder();
+const textDecoder = new TextDecoder();
+
+class WireWriter {
+    constructor(capacity = 64) {
+        this.bytes = new Uint8Array(capacity);
+        this.view = new DataView(this.bytes.buffer);
+        this.length = 0;
+    }
+
+    reserve(n) {
+        if (this.length + n <= this.bytes.length) return;
+        const bytes = new Uint8Array(Math.max(this.bytes.length * 2, this.length + n));
+        bytes.set(this.bytes);
+        this.bytes = bytes;
+        this.view = new DataView(bytes.buffer);
+    }
+
+    u8(v) { this.reserve(1); this.view.setUint8(this.length, v); this.length += 1; }
+    u16(v) { this.reserve(2); this.view.setUint16(this.length, v, true); this.length += 2; }
+    u32(v) { this.reserve(4); this.view.setUint32(this.length, v, true); this.length += 4; }
+    f32(v) { this.reserve(4); this.view.setFloat32(this.length, v, true); this.length += 4; }
+    f64(v) { this.reserve(8); this.view.setFloat64(this.length, v, true); this.length += 8; }
+
+    varint(v) {
+        while (v >= 0x80) {
+            this.u8((v % 0x80) | 0x80);
+            v = Math.floor(v / 0x80);
+        }
+        this.u8(v);
+    }
+
+    string(s) {
+        const bytes = textEncoder.encode(s);
+        this.varint(bytes.length);
+        this.reserve(bytes.length);
+        this.bytes.set(bytes, this.length);
+        this.length += bytes.length;
+    }
+
+    finish() {
+        return this.bytes.slice(0, this.length).buffer;
+    }
+}
+
+class WireReader {
+    constructor(buffer) {
+        this.view = new DataView(buffer);
+        this.bytes = new Uint8Array(buffer);
+        this.pos = 0;
+    }
+
+    atEnd() { return this.pos >= this.bytes.length; }
+    u8() { return this.view.getUint8(this.pos++); }
+    i16() { const v = this.view.getInt16(this.pos, true); this.pos += 2; return v; }
+    i32() { const v = this.view.getInt32(this.pos, true); this.pos += 4; return v; }
+    u32() { const v = this.view.getUint32(this.pos, true); this.pos += 4; return v; }
+    f32() { const v = this.view.getFloat32(this.pos, true); this.pos += 4; return v; }
+    f64() { const v = this.view.getFloat64(this.pos, true); this.pos += 8; return v; }
+
+    varint() {
+        let v = 0;
+        for (let scale = 1; ; scale *= 0x80) {
+            const byte = this.u8();
+            v += (byte & 0x7f) * scale;
+            if (!(byte & 0x80)) return v;
+        }
+    }
+
+    string() {
+        const length = this.varint();
+        const s = textDecoder.decode(this.bytes.subarray(this.pos, this.pos + length));
+        this.pos += length;
+        return s;
+    }
+}
+
+export function encodePing(clientTime) {
+    const out = new WireWriter(16);
+    out.u8(WIRE_VERSION);
+    out.u8(Record.PING);
+    out.f64(clientTime);
+    return out.finish();
+}
+
+export function encodePlayerMove(x, y) {
+    const out = new WireWriter(16);
+    out.u8(WIRE_VERSION);
+    out.u8(Record.PLAYER_MOVE);
+    out.f32(x);
+    out.f32(y);
+    return out.finish();
+}
+
+// Takes the same fields as the JSON "movement" message for a snowball.
+export function encodeSnowballMove(msg) {
+    const out = new WireWriter(96);
+    out.u8(WIRE_VERSION);
+    out.u8(Record.SNOWBALL_MOVE);
+    out.string(msg.id);
+    out.u8(msg.charging ? WIRE_CHARGING : 0);
+    out.f32(msg.position.x);
+    out.f32(msg.position.y);
+    out.f32(msg.velocity ? msg.velocity.x : 0);
+    out.f32(msg.velocity ? msg.velocity.y : 0);
+    out.f32(msg.size ?? 1);
+    out.u16(Math.round(msg.damage ?? 5));
+    out.f64(msg.timeEmission ?? 0);
+    out.u32(msg.lifeLength ?? WIRE_NO_EXPIRY);
+    return out.finish();
+}
+
+// Decodes a server frame into messages shaped like the JSON ones. names
+// maps entity indices to string IDs and is updated by NAME records;
+// serverNow is the current server wall-clock time. A CELL record becomes a
+// "cell" message listing the IDs of the STATE records that follow it.
+export function decodeFrame(buffer, names, serverNow) {
+    const messages = [];
+    const reader = new WireReader(buffer);
+    let cell = null;
+    if (reader.u8() !== WIRE_VERSION) return messages;
+
+    while (!reader.atEnd()) {
+        switch (reader.u8()) {
+            case Record.NAME: {
+                const index = reader.varint();
+                names.set(index, reader.string());
+                break;
+            }
+            case Record.STATE: {
+                const messageType = MESSAGE_TYPES[reader.u8()];
+                const id = names.get(reader.varint());
+                const flags = reader.u8();
+                const x = reader.f32(), y = reader.f32();
+                const vx = reader.f32(), vy = reader.f32();
+                const size = reader.f32();
+                const lifeLength = reader.u32();
+                const newHealth = reader.i16();
+                // A NAME can be missing if the entity died before it was sent.
+                if (id === undefined) break;
+                if (cell) cell.ids.push(id);
+                messages.push({
+                    messageType,
+                    id,
+                    objectType: OBJECT_TYPES[flags & 3],
+                    position: { x, y },
+                    velocity: { x: vx, y: vy },
+                    size,
+                    charging: (flags & WIRE_CHARGING) !== 0,
+                    expireDate: lifeLength === WIRE_NO_EXPIRY ? Infinity : serverNow + lifeLength,
+                    isDead: (flags & WIRE_DEAD) !== 0,
+                    newHealth,
+                });
+                break;
+            }
+            case Record.CELL: {
+                const row = reader.i32(), col = reader.i32();
+                cell = { messageType: "cell", key: `${row},${col}`, ids: [], serverNow };
+                messages.push(cell);
+                break;
+            }
+            case Record.PONG: {
+                const clientTime = reader.f64();
+                const serverTime = reader.f64();
+                messages.push({ messageType: "pong", clientTime, serverTime });
+                break;
+            }
+            default:
+                // Records carry no length, so the rest cannot be parsed.
+                console.warn("Unknown wire record at", reader.pos - 1);
+                return messages;
+        }
+    }
+    return messages;
+}
@@ -0,0 +1,177 @@
+// Compares dense cell layouts on view-sized rectangle scans and
+// radius-sized square scans: the original rows of individually allocated
+// cells, the flat row-major array Grid uses, and a flat Z-order (Morton)
+// array walked row by row. Cache misses are read from perf counters when
+// the kernel allows it.
+// Build with `make bench` and run ./build/bench/cell_layout_bench.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "grid.h"
+#include "constants.h"
+
+namespace {
+
+constexpr int kCellSize = 100;
+constexpr int kRows = 512, kCols = 512;
+constexpr int kQueries = 20000;
+
+// Counts hardware cache misses on this thread; reports -1 when unavailable.
+class CacheMissCounter {
+public:
+    CacheMissCounter() {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+    ~CacheMissCounter() { if (fd_ >= 0) close(fd_); }
+
+    void Start() {
+        if (fd_ < 0) return;
+        ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    long long Stop() {
+        if (fd_ < 0) return -1;
+        ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+        long long count = 0;
+        if (read(fd_, &count, sizeof(count)) != sizeof(count)) return -1;
+        return count;
+    }
+
+private:
+    int fd_;
+};
+
+// Interleaves the bits of col (even positions) and row (odd positions).
+uint32_t MortonIndex(int row, int col) {
+    auto spread = [](uint32_t v) {
+        v &= 0x0000ffff;
+        v = (v | (v << 8)) & 0x00ff00ff;
+        v = (v | (v << 4)) & 0x0f0f0f0f;
+        v = (v | (v << 2)) & 0x33333333;
+        v = (v | (v << 1)) & 0x55555555;
+        return v;
+    };
+    return spread(static_cast<uint32_t>(col)) | (spread(static_cast<uint32_t>(row)) << 1);
+}
+
+struct Window {
+    int lower_row, upper_row, left_col, right_col;
+};
+
+std::vector<Window> MakeWindows(int half_rows, int half_cols) {
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> row(0, kRows - 1), col(0, kCols - 1);
+    std::vector<Window> windows;
+    for (int i = 0; i < kQueries; i++) {
+        int r = row(rng), c = col(rng);
+        windows.push_back({std::max(r - half_rows, 0), std::min(r + half_rows, kRows - 1),
+                           std::max(c - half_cols, 0), std::min(c + half_cols, kCols - 1)});
+    }
+    return windows;
+}
+
+// Scans every window, reading cells through at(r, c).
+template <typename At>
+void Scan(const char *name, const std::vector<Window> &windows, At at) {
+    CacheMissCounter counter;
+    auto start = std::chrono::steady_clock::now();
+    counter.Start();
+    double sum = 0;
+    for (const auto &w : windows) {
+        for (int r = w.lower_row; r <= w.upper_row; r++) {
+            for (int c = w.left_col; c <= w.right_col; c++) {
+                const Cell &cell = at(r, c);
+                for (size_t i = 0; i < cell.Size(); i++) sum += cell.xs[i];
+            }
+        }
+    }
+    long long misses = counter.Stop();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    if (misses >= 0) {
+        std::printf("  %-10s %10.2f ms %14lld misses %12.1f misses/query  (checksum %.0f)\n",
+                    name, ms, misses, static_cast<double>(misses) / windows.size(), sum);
+    } else {
+        std::printf("  %-10s %10.2f ms %14s misses  (checksum %.0f)\n", name, ms, "n/a", sum);
+    }
+}
+
+// One object per cell, centered in it.
+void Fill(Cell &cell, const std::shared_ptr<GameObject> &obj, int r, int c) {
+    obj->set_x(c * kCellSize + 50);
+    obj->set_y(r * kCellSize + 50);
+    cell.Append(obj);
+}
+
+// A flat layout: cells in one array at index(r, c), filled in memory order
+// so each cell's arrays are allocated in the order the cells are placed.
+template <typename Index>
+void RunFlat(const char *name, const std::vector<Window> &windows, Index index, size_t cell_count) {
+    std::vector<std::pair<uint32_t, std::pair<int, int>>> order;
+    for (int r = 0; r < kRows; r++) {
+        for (int c = 0; c < kCols; c++) order.push_back({index(r, c), {r, c}});
+    }
+    std::sort(order.begin(), order.end());
+
+    std::vector<Cell> cells(cell_count);
+    auto obj = std::make_shared<Player>();
+    for (const auto &[i, pos] : order) Fill(cells[i], obj, pos.first, pos.second);
+    Scan(name, windows, [&](int r, int c) -> const Cell & { return cells[index(r, c)]; });
+}
+
+// The layout before the flat array: a vector of rows of separately
+// allocated cells.
+void RunNested(const std::vector<Window> &windows) {
+    std::vector<std::vector<std::unique_ptr<Cell>>> cells(kRows);
+    auto obj = std::make_shared<Player>();
+    for (int r = 0; r < kRows; r++) {
+        for (int c = 0; c < kCols; c++) {
+            cells[r].push_back(std::make_unique<Cell>());
+            Fill(*cells[r].back(), obj, r, c);
+        }
+    }
+    Scan("nested", windows, [&](int r, int c) -> const Cell & { return *cells[r][c]; });
+}
+
+void RunAll(const std::vector<Window> &windows) {
+    RunNested(windows);
+    RunFlat("row-major", windows, [](int r, int c) { return static_cast<uint32_t>(r * kCols + c); },
+            static_cast<size_t>(kRows) * kCols);
+    RunFlat("morton", windows, MortonIndex, MortonIndex(kRows - 1, kCols - 1) + 1);
+}
+
+}  // namespace
+
+int main() {
+    std::printf("%dx%d cells of %d px, %d queries per pattern\n", kRows, kCols, kCellSize, kQueries);
+
+    // Twice the fixed view in each direction, as UpdatePlayerView queries it.
+    int view_rows = constants::FIXED_VIEW_HEIGHT / kCellSize + 1;
+    int view_cols = constants::FIXED_VIEW_WIDTH / kCellSize + 1;
+    std::printf("view window (%dx%d cells):\n", 2 * view_rows + 1, 2 * view_cols + 1);
+    RunAll(MakeWindows(view_rows, view_cols));
+
+    std::printf("radius window (7x7 cells):\n");
+    RunAll(MakeWindows(3, 3));
+    return 0;
+}
@@ -0,0 +1,164 @@
+// Compares the pairwise GameObject::Collide path against the batched
+// circle-versus-many kernel at several candidate counts per player.
+// Build with `make bench` and run ./build/bench/collision_bench.
+
+#include <bit>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "collision.h"
+#include "game_object.h"
+
+namespace {
+
+constexpr int kPlayers = 256;
+constexpr int kRounds = 50;
+// Candidates are spread over a square this far around the player, about
+// what a radius query returns at 128 px cells.
+constexpr double kSpread = 200;
+
+using Clock = std::chrono::steady_clock;
+
+double NanosSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+struct Scene {
+    std::vector<std::shared_ptr<Player>> players;
+    std::vector<std::vector<std::shared_ptr<GameObject>>> candidates;
+};
+
+Scene MakeScene(int per_player) {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> offset(-kSpread, kSpread), size(5, 10);
+    long long now = TickClock::SteadyMillis();
+
+    Scene scene;
+    for (int p = 0; p < kPlayers; p++) {
+        auto player = std::make_shared<Player>();
+        player->set_x(1000 + p * 10);
+        player->set_y(1000);
+        player->set_size(20);
+        scene.players.push_back(player);
+
+        auto &list = scene.candidates.emplace_back();
+        for (int i = 0; i < per_player; i++) {
+            auto snowball = std::make_shared<Snowball>("snowball_" + std::to_string(i));
+            snowball->set_x(player->get_x() + offset(rng));
+            snowball->set_y(player->get_y() + offset(rng));
+            // Still extrapolated on every test, but at zero velocity both
+            // paths see the same positions whenever they read the clock.
+            snowball->set_vx(0);
+            snowball->set_vy(0);
+            snowball->set_size(size(rng));
+            snowball->set_time_update(now);
+            list.push_back(snowball);
+        }
+    }
+    return scene;
+}
+
+void Revive(Scene &scene) {
+    for (auto &list : scene.candidates) {
+        for (auto &obj : list) obj->set_is_dead(false);
+    }
+}
+
+struct Result {
+    double pairwise_ns, batched_ns, kernel_ns, scalar_ns;
+    size_t pairwise_hits, batched_hits;
+};
+
+Result Run(int per_player) {
+    Scene scene = MakeScene(per_player);
+    Result result{};
+    double tests = static_cast<double>(kPlayers) * per_player * kRounds;
+
+    // The pairwise path: one Collide per pair.
+    double total = 0;
+    for (int round = 0; round < kRounds; round++) {
+        Revive(scene);
+        auto start = Clock::now();
+        long long now = TickClock::SteadyMillis();
+        for (int p = 0; p < kPlayers; p++) {
+            for (const auto &obj : scene.candidates[p]) {
+                if (obj->Collide(scene.players[p], now)) result.pairwise_hits++;
+            }
+        }
+        total += NanosSince(start);
+    }
+    result.pairwise_ns = total / tests;
+
+    // The batched path as UpdatePlayerView runs it: gather positions from
+    // the entity store, build the hit mask, walk the set bits.
+    std::vector<EntityId> ids;
+    std::vector<double> xs, ys, sizes;
+    std::vector<uint64_t> hits;
+    total = 0;
+    for (int round = 0; round < kRounds; round++) {
+        Revive(scene);
+        auto start = Clock::now();
+        long long now = TickClock::SteadyMillis();
+        for (int p = 0; p < kPlayers; p++) {
+            const auto &list = scene.candidates[p];
+            const auto &player = scene.players[p];
+            ids.clear();
+            sizes.clear();
+            for (const auto &obj : list) {
+                ids.push_back(obj->get_id());
+                sizes.push_back(obj->get_size());
+            }
+            xs.resize(list.size());
+            ys.resize(list.size());
+            hits.resize(HitMaskWords(list.size()));
+            EvaluatePositions(ids, now, xs, ys);
+            CircleHitMask(player->get_cur_x(now), player->get_cur_y(now), player->get_size(),
+                          xs.data(), ys.data(), sizes.data(), list.size(), hits.data());
+            for (size_t w = 0; w < hits.size(); w++) {
+                for (uint64_t bits = hits[w]; bits; bits &= bits - 1) {
+                    const auto &obj = list[w * 64 + std::countr_zero(bits)];
+                    if (obj->get_is_dead()) continue;
+                    obj->set_is_dead(true);
+                    result.batched_hits++;
+                }
+            }
+        }
+        total += NanosSince(start);
+    }
+    result.batched_ns = total / tests;
+
+    // The kernels alone, on positions that are already packed.
+    auto time_kernel = [&](auto kernel) {
+        double elapsed = 0;
+        for (int round = 0; round < kRounds; round++) {
+            auto start = Clock::now();
+            for (int p = 0; p < kPlayers; p++) {
+                kernel(scene.players[p]->get_x(), scene.players[p]->get_y(), 20.0, xs.data(), ys.data(),
+                       sizes.data(), xs.size(), hits.data());
+            }
+            elapsed += NanosSince(start);
+        }
+        return elapsed / tests;
+    };
+    result.kernel_ns = time_kernel(CircleHitMask);
+    result.scalar_ns = time_kernel(CircleHitMaskScalar);
+    return result;
+}
+
+}  // namespace
+
+int main() {
+    std::printf("%d players, %d rounds, candidates within %.0f px\n", kPlayers, kRounds, kSpread);
+    std::printf("%10s %14s %14s %14s %14s %10s %10s\n", "per player", "pairwise ns", "batched ns",
+                "kernel ns", "scalar ns", "hits", "batched");
+
+    for (int per_player : {4, 16, 64, 256}) {
+        Result r = Run(per_player);
+        std::printf("%10d %14.2f %14.2f %14.2f %14.2f %10zu %10zu\n", per_player, r.pairwise_ns, r.batched_ns,
+                    r.kernel_ns, r.scalar_ns, r.pairwise_hits, r.batched_hits);
+    }
+    return 0;
+}
@@ -0,0 +1,126 @@
+// Compares the full-width entity component layout against the compact
+// ones (float32 or 16.16 fixed-point coordinates, 32-bit timestamps):
+// bytes per entity, how many entities keep their hot state within a cache
+// budget, and the throughput of a kinematics sweep over each layout.
+// Build with `make bench` and run ./build/bench/entity_bench.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <unistd.h>
+
+#include "entity_store.h"
+
+namespace {
+
+constexpr int kCellSize = 128;
+constexpr int kRounds = 20;
+
+using Clock = std::chrono::steady_clock;
+
+volatile size_t sink;
+
+// Hot components that keep their width in every layout: generation,
+// health, damage, row, col, owner, team mask, type, dead and simulated.
+constexpr size_t kFixedHotBytes = 4 + 4 * 4 + 8 + 4 + 1 + 1 + 1;
+
+template <typename Coord, typename Time, typename Duration>
+struct Layout {
+    const char *name;
+    std::vector<Coord> xs, ys, vxs, vys, sizes;
+    std::vector<Time> time_updates;
+    std::vector<Duration> life_lengths;
+    std::vector<int> rows, cols;
+
+    explicit Layout(const char *name) : name(name) {}
+
+    static constexpr size_t HotBytes() {
+        return 5 * sizeof(Coord) + sizeof(Time) + sizeof(Duration) + kFixedHotBytes;
+    }
+
+    void Fill(size_t n, long long now) {
+        std::mt19937 rng(11);
+        std::uniform_real_distribution<double> pos(0, 8000), vel(-800, 800), size(5, 25);
+        std::uniform_int_distribution<long long> age(0, 1000);
+        xs.resize(n); ys.resize(n); vxs.resize(n); vys.resize(n); sizes.resize(n);
+        time_updates.resize(n); life_lengths.resize(n);
+        rows.resize(n); cols.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            xs[i] = pos(rng);
+            ys[i] = pos(rng);
+            vxs[i] = vel(rng);
+            vys[i] = vel(rng);
+            sizes[i] = size(rng);
+            time_updates[i] = now - age(rng);
+            life_lengths[i] = 4000;
+            rows[i] = static_cast<int>(ys[i]) / kCellSize;
+            cols[i] = static_cast<int>(xs[i]) / kCellSize;
+        }
+    }
+
+    // The per-entity work of SweepChunkScalar. Returns the flagged count so
+    // the loop cannot be dropped.
+    size_t Sweep(long long now, std::vector<uint8_t> &flags) const {
+        size_t flagged = 0;
+        for (size_t i = 0; i < xs.size(); i++) {
+            long long elapsed = now - time_updates[i];
+            int cur_x = static_cast<int>(xs[i] + vxs[i] * (elapsed / 1000.0));
+            int cur_y = static_cast<int>(ys[i] + vys[i] * (elapsed / 1000.0));
+            int col = static_cast<int>(std::floor(cur_x / static_cast<double>(kCellSize)));
+            int row = static_cast<int>(std::floor(cur_y / static_cast<double>(kCellSize)));
+            flags[i] = (row != rows[i] || col != cols[i]) | (elapsed > life_lengths[i]) << 1;
+            flagged += flags[i] != 0;
+        }
+        return flagged;
+    }
+};
+
+size_t CacheBudget() {
+    long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    return l2 > 0 ? static_cast<size_t>(l2) : 1 << 20;
+}
+
+template <typename L>
+void Report(L layout, size_t budget, double baseline_bytes) {
+    long long now = TickClock::SteadyMillis();
+
+    std::printf("%-22s %6zu %10zu %9.2fx", layout.name, L::HotBytes(), budget / L::HotBytes(),
+                baseline_bytes / L::HotBytes());
+
+    for (size_t n : {size_t(1) << 14, size_t(1) << 20}) {
+        layout.Fill(n, now);
+        std::vector<uint8_t> flags(n);
+        size_t flagged = 0;
+        auto start = Clock::now();
+        for (int round = 0; round < kRounds; round++) flagged += layout.Sweep(now + round, flags);
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        std::printf(" %12.2f", ns / (static_cast<double>(n) * kRounds));
+        sink = flagged;
+    }
+    std::printf("\n");
+}
+
+}  // namespace
+
+int main() {
+    size_t budget = CacheBudget();
+    std::printf("This build: EntityChunk holds %zu bytes per entity (%zu with names), %zu hot\n",
+                (sizeof(EntityChunk) - sizeof(EntityChunk::names)) / ENTITY_CHUNK_SIZE,
+                sizeof(EntityChunk) / ENTITY_CHUNK_SIZE,
+                5 * sizeof(EntityCoord) + sizeof(EntityTime) + sizeof(EntityDuration) + kFixedHotBytes);
+    std::printf("Hot state = kinematics plus health, cell, owner, team and flags; names are cold.\n");
+    std::printf("Cache budget per worker: %zu KiB (L2)\n\n", budget / 1024);
+
+    std::printf("%-22s %6s %10s %10s %12s %12s\n", "layout", "bytes", "in budget", "vs double",
+                "ns/ent 16K", "ns/ent 1M");
+
+    double baseline = Layout<double, long long, long long>::HotBytes();
+    Report(Layout<double, long long, long long>("double, int64 ticks"), budget, baseline);
+    Report(Layout<double, Tick32, Span32>("double, 32-bit ticks"), budget, baseline);
+    Report(Layout<float, Tick32, Span32>("float32, 32-bit ticks"), budget, baseline);
+    Report(Layout<Fixed16, Tick32, Span32>("16.16, 32-bit ticks"), budget, baseline);
+    return 0;
+}
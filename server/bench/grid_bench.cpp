@@ -0,0 +1,103 @@
+// Compares the dense and sparse grid modes at several world sizes.
+// Build with `make bench` and run ./build/bench/grid_bench.
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "grid.h"
+#include "constants.h"
+
+namespace {
+
+constexpr int kCellSize = 100;
+constexpr int kPlayers = 1000;
+constexpr int kSnowballs = 4000;
+constexpr int kRounds = 20;
+
+using Clock = std::chrono::steady_clock;
+
+double MillisSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+struct Result {
+    double build_ms, insert_ms, update_ms, search_ms;
+    size_t cells;
+    size_t found;
+};
+
+Result Run(int world, GridMode mode) {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> pos(0, world - 1);
+    std::uniform_real_distribution<double> vel(-800, 800);
+
+    std::vector<std::shared_ptr<GameObject>> objects;
+    for (int i = 0; i < kPlayers; i++) {
+        auto player = std::make_shared<Player>();
+        player->set_x(pos(rng));
+        player->set_y(pos(rng));
+        objects.push_back(player);
+    }
+    for (int i = 0; i < kSnowballs; i++) {
+        auto snowball = std::make_shared<Snowball>("snowball_" + std::to_string(i));
+        snowball->set_x(pos(rng));
+        snowball->set_y(pos(rng));
+        snowball->set_vx(vel(rng));
+        snowball->set_vy(vel(rng));
+        snowball->set_life_length(1LL << 40);
+        objects.push_back(snowball);
+    }
+
+    Result result{};
+    auto start = Clock::now();
+    Grid grid(world, world, kCellSize, mode);
+    result.build_ms = MillisSince(start);
+
+    start = Clock::now();
+    for (auto &obj : objects) grid.Insert(obj);
+    result.insert_ms = MillisSince(start);
+
+    // Advance snowballs by one 10 ms tick per round.
+    start = Clock::now();
+    for (int round = 1; round <= kRounds; round++) {
+        for (size_t i = kPlayers; i < objects.size(); i++) grid.Update(objects[i], round * 10);
+    }
+    result.update_ms = MillisSince(start) / kRounds;
+
+    std::vector<std::shared_ptr<GameObject>> buffer;
+    start = Clock::now();
+    for (int round = 0; round < kRounds; round++) {
+        for (int i = 0; i < kPlayers; i++) {
+            double lower_y = objects[i]->get_y() - constants::FIXED_VIEW_HEIGHT;
+            double left_x = objects[i]->get_x() - constants::FIXED_VIEW_WIDTH;
+            grid.Search(lower_y, lower_y + 2 * constants::FIXED_VIEW_HEIGHT,
+                        left_x, left_x + 2 * constants::FIXED_VIEW_WIDTH, buffer);
+            result.found += buffer.size();
+        }
+    }
+    result.search_ms = MillisSince(start) / kRounds;
+    result.found /= kRounds;
+    result.cells = grid.CellCount();
+    return result;
+}
+
+}  // namespace
+
+int main() {
+    std::printf("%d players, %d snowballs, cell size %d\n", kPlayers, kSnowballs, kCellSize);
+    std::printf("%8s %7s %10s %10s %10s %10s %10s %10s\n",
+                "world", "mode", "cells", "build ms", "insert ms", "tick ms", "views ms", "found");
+
+    for (int world : {1600, 8000, 25600, 51200}) {
+        for (GridMode mode : {GridMode::DENSE, GridMode::SPARSE}) {
+            Result r = Run(world, mode);
+            std::printf("%8d %7s %10zu %10.2f %10.2f %10.3f %10.2f %10zu\n",
+                        world, mode == GridMode::DENSE ? "dense" : "sparse", r.cells,
+                        r.build_ms, r.insert_ms, r.update_ms, r.search_ms, r.found);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,122 @@
+// Compares the JSON and binary (wire.h) encodings of object updates:
+// bytes per update and the cost to encode and decode one.
+// Build with `make bench` and run ./build/bench/wire_bench.
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "game_object.h"
+#include "wire.h"
+
+namespace {
+
+constexpr int kObjects = 1000;
+constexpr int kRounds = 50;
+
+using Clock = std::chrono::steady_clock;
+
+double NanosSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+// Reads one STATE record the way a client would.
+double DecodeState(WireReader &in) {
+    in.GetU8();
+    in.GetU8();
+    in.GetVarint();
+    in.GetU8();
+    double sum = in.GetF32() + in.GetF32() + in.GetF32() + in.GetF32() + in.GetF32();
+    sum += in.GetU32() + in.GetU16();
+    return sum;
+}
+
+}  // namespace
+
+int main() {
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<double> pos(0, 8000), vel(-800, 800), size(5, 25);
+    long long now = TickClock::SteadyMillis();
+
+    std::vector<std::shared_ptr<GameObject>> objects;
+    for (int i = 0; i < kObjects; i++) {
+        std::shared_ptr<GameObject> obj;
+        if (i % 4 == 0) {
+            obj = std::make_shared<Player>();
+            obj->set_name("3f2c7a9e-5b1d-4c8e-9a6f-" + std::to_string(100000000000LL + i));
+        } else {
+            obj = std::make_shared<Snowball>("snowball_3f2c7a9e-5b1d-4c8e-9a6f_" + std::to_string(now + i));
+        }
+        obj->set_x(pos(rng));
+        obj->set_y(pos(rng));
+        obj->set_vx(vel(rng));
+        obj->set_vy(vel(rng));
+        obj->set_size(size(rng));
+        obj->set_time_update(now);
+        obj->set_life_length(3000);
+        objects.push_back(obj);
+    }
+
+    // Encode: one message per update, as SendMessageToClient builds them.
+    std::vector<std::string> json_messages(kObjects);
+    size_t json_bytes = 0;
+    auto start = Clock::now();
+    for (int round = 0; round < kRounds; round++) {
+        for (int i = 0; i < kObjects; i++) json_messages[i] = objects[i]->StateJson("movement", now).dump();
+    }
+    double json_encode_ns = NanosSince(start) / (kObjects * kRounds);
+    for (const auto &message : json_messages) json_bytes += message.size();
+
+    // Binary frames after the first, once the client has every NAME.
+    std::unordered_set<uint64_t> named;
+    std::vector<std::string> wire_messages(kObjects);
+    WireWriter frame;
+    for (const auto &obj : objects) obj->EncodeState(frame, named, WireMessage::MOVEMENT, now);
+    size_t wire_bytes = 0;
+    start = Clock::now();
+    for (int round = 0; round < kRounds; round++) {
+        for (int i = 0; i < kObjects; i++) {
+            frame.Clear();
+            frame.PutU8(WIRE_VERSION);
+            objects[i]->EncodeState(frame, named, WireMessage::MOVEMENT, now);
+            wire_messages[i] = frame.get_data();
+        }
+    }
+    double wire_encode_ns = NanosSince(start) / (kObjects * kRounds);
+    for (const auto &message : wire_messages) wire_bytes += message.size();
+
+    // Decode.
+    double sink = 0;
+    start = Clock::now();
+    for (int round = 0; round < kRounds; round++) {
+        for (const auto &message : json_messages) {
+            json data = json::parse(message);
+            sink += data["position"]["x"].get<double>();
+        }
+    }
+    double json_decode_ns = NanosSince(start) / (kObjects * kRounds);
+
+    start = Clock::now();
+    for (int round = 0; round < kRounds; round++) {
+        for (const auto &message : wire_messages) {
+            WireReader in(message);
+            in.GetU8();
+            sink += DecodeState(in);
+        }
+    }
+    double wire_decode_ns = NanosSince(start) / (kObjects * kRounds);
+
+    std::printf("%d updates, %d rounds\n", kObjects, kRounds);
+    std::printf("%8s %14s %14s %14s\n", "", "bytes/update", "encode ns", "decode ns");
+    std::printf("%8s %14.1f %14.1f %14.1f\n", "json", double(json_bytes) / kObjects, json_encode_ns,
+                json_decode_ns);
+    std::printf("%8s %14.1f %14.1f %14.1f\n", "binary", double(wire_bytes) / kObjects, wire_encode_ns,
+                wire_decode_ns);
+    std::printf("%8s %13.1fx %13.1fx %13.1fx\n", "ratio", double(json_bytes) / wire_bytes,
+                json_encode_ns / wire_encode_ns, json_decode_ns / wire_decode_ns);
+    return sink == 0;
+}
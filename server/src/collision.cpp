@@ -0,0 +1,62 @@
+#include "collision.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define COLLISION_X86 1
+#endif
+
+static inline bool Overlaps(double x, double y, double r, double ox, double oy, double or_) {
+    double dx = ox - x, dy = oy - y, reach = or_ + r;
+    return dx * dx + dy * dy < reach * reach;
+}
+
+void CircleHitMaskScalar(double x, double y, double r, const double *xs, const double *ys, const double *rs,
+                         size_t n, uint64_t *mask) {
+    std::memset(mask, 0, HitMaskWords(n) * sizeof(uint64_t));
+    for (size_t i = 0; i < n; i++) {
+        if (Overlaps(x, y, r, xs[i], ys[i], rs[i])) mask[i / 64] |= uint64_t(1) << (i % 64);
+    }
+}
+
+#ifdef COLLISION_X86
+// Four circles per iteration; the tail falls back to the scalar test.
+__attribute__((target("avx2")))
+static void CircleHitMaskAvx2(double x, double y, double r, const double *xs, const double *ys, const double *rs,
+                              size_t n, uint64_t *mask) {
+    std::memset(mask, 0, HitMaskWords(n) * sizeof(uint64_t));
+
+    const __m256d cx = _mm256_set1_pd(x), cy = _mm256_set1_pd(y), cr = _mm256_set1_pd(r);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(xs + i), cx);
+        __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(ys + i), cy);
+        __m256d reach = _mm256_add_pd(_mm256_loadu_pd(rs + i), cr);
+        __m256d dist = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+        uint64_t hits = _mm256_movemask_pd(_mm256_cmp_pd(dist, _mm256_mul_pd(reach, reach), _CMP_LT_OQ));
+        mask[i / 64] |= hits << (i % 64);
+    }
+    for (; i < n; i++) {
+        if (Overlaps(x, y, r, xs[i], ys[i], rs[i])) mask[i / 64] |= uint64_t(1) << (i % 64);
+    }
+}
+#endif
+
+using HitMaskFn = void (*)(double, double, double, const double *, const double *, const double *,
+                           size_t, uint64_t *);
+
+static HitMaskFn ResolveHitMask() {
+#ifdef COLLISION_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return CircleHitMaskAvx2;
+#endif
+    return CircleHitMaskScalar;
+}
+
+static const HitMaskFn hit_mask_impl = ResolveHitMask();
+
+void CircleHitMask(double x, double y, double r, const double *xs, const double *ys, const double *rs,
+                   size_t n, uint64_t *mask) {
+    hit_mask_impl(x, y, r, xs, ys, rs, n, mask);
+}
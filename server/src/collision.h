@@ -0,0 +1,22 @@
+#ifndef COLLISION_H
+#define COLLISION_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Words of a hit mask covering n circles.
+inline size_t HitMaskWords(size_t n) { return (n + 63) / 64; }
+
+// Tests the circle (x, y, r) against n circles given as parallel arrays and
+// sets bit i of mask (HitMaskWords(n) words, overwritten) when circle i
+// overlaps it, using the same strict test as GameObject::Collide.
+//
+// Uses AVX2 when the CPU has it, and a scalar loop otherwise.
+void CircleHitMask(double x, double y, double r, const double *xs, const double *ys, const double *rs,
+                   size_t n, uint64_t *mask);
+
+// The scalar implementation, exposed for comparison.
+void CircleHitMaskScalar(double x, double y, double r, const double *xs, const double *ys, const double *rs,
+                         size_t n, uint64_t *mask);
+
+#endif
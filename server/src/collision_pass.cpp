@@ -0,0 +1,24 @@
+#include "collision_pass.h"
+
+CollisionPass collision_pass;
+
+HitInbox &CollisionPass::Inbox(uint32_t partition) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto &inbox = inboxes_[partition];
+    if (!inbox) inbox = std::make_unique<HitInbox>();
+    return *inbox;
+}
+
+size_t CollisionPass::Run(Grid &grid, long long current_time) {
+    size_t hits = 0;
+    grid.ForEachContact(current_time, [&](const std::shared_ptr<GameObject> &player,
+                                          const std::shared_ptr<GameObject> &snowball) {
+        if (snowball->get_is_dead() || player->get_is_dead()) return;
+        if (!snowball->get_damage() || !snowball->CanHurt(*player)) return;
+
+        snowball->set_is_dead(true);
+        Inbox(entity_store.PartitionOf(player->get_id().index)).Push({player, snowball->get_damage()});
+        hits++;
+    });
+    return hits;
+}
@@ -0,0 +1,57 @@
+#ifndef COLLISION_PASS_H
+#define COLLISION_PASS_H
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "grid.h"
+#include "game_object.h"
+
+// A snowball hitting a player, to be applied by the player's worker.
+struct HitEvent {
+    std::shared_ptr<GameObject> target;
+    int damage;
+};
+
+// Hits waiting for one worker. Any thread may push; the worker drains.
+class HitInbox {
+    std::mutex mtx_;
+    std::vector<HitEvent> events_;
+public:
+    void Push(HitEvent event) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        events_.push_back(std::move(event));
+    }
+    // Replaces out with the pending events.
+    void Drain(std::vector<HitEvent> &out) {
+        out.clear();
+        std::lock_guard<std::mutex> lock(mtx_);
+        out.swap(events_);
+    }
+};
+
+// Resolves snowball hits for the whole world once per tick, on one thread.
+//
+// Each contact the grid reports is checked against the game rules; the
+// snowball is marked dead by the pass itself, so it hurts at most one
+// player, once. The hit is then queued for the worker that created the
+// target (its entity partition), which owns the player's connection and
+// health.
+class CollisionPass {
+    std::mutex mtx_;
+    std::unordered_map<uint32_t, std::unique_ptr<HitInbox>> inboxes_;
+
+public:
+    // Inbox of the worker bound to an entity partition.
+    HitInbox &Inbox(uint32_t partition);
+
+    // Runs one tick over grid and returns the number of hits queued.
+    // Only one thread may run passes.
+    size_t Run(Grid &grid, long long current_time);
+};
+
+extern CollisionPass collision_pass;
+
+#endif
@@ -1,9 +1,41 @@
 #ifndef CONSTANTS_H
 #define CONSTANTS_H
 
+#include <cstddef>
+
 namespace constants {
     constexpr int FIXED_VIEW_WIDTH = 1600;
     constexpr int FIXED_VIEW_HEIGHT = 900;
+    // Upper bound on live entities (players and snowballs) server-wide.
+    constexpr unsigned MAX_ENTITIES = 1u << 20;
+    // Pool block size for a player or snowball plus its shared_ptr control
+    // block (one cache line), and blocks added each time a pool grows.
+    constexpr size_t OBJECT_POOL_BLOCK_SIZE = 64;
+    constexpr size_t OBJECT_POOL_SLAB_BLOCKS = 1024;
+    // Worlds with more cells than this switch the grid to sparse mode.
+    constexpr long long DENSE_GRID_MAX_CELLS = 1 << 16;
+    // Interval of the collision pass, matching the view updates.
+    constexpr int COLLISION_TICK_MS = 10;
+    // How far a moving object may travel past its cell before the next
+    // grid update re-buckets it (800 px/s over a 25 ms update gap).
+    constexpr double MAX_OBJECT_DRIFT = 20.0;
+    // Largest object extent the server accepts from clients, whose players
+    // and snowballs top out at 20 px.
+    constexpr double MAX_OBJECT_SIZE = 32.0;
+    // Cell size used until grid statistics recommend another one.
+    constexpr int DEFAULT_GRID_CELL_SIZE = 128;
+    // Cell sizes the tuner chooses from: powers of two in this range, so a
+    // recommendation can still map to a FixedGrid specialization.
+    constexpr int MIN_GRID_CELL_SIZE = 32;
+    constexpr int MAX_GRID_CELL_SIZE = 1024;
+    // Relative cost of visiting one cell (lock, unlock, loop setup) versus
+    // yielding one object from it, used by the cell-size cost model.
+    constexpr double GRID_CELL_VISIT_COST = 4.0;
+    constexpr double GRID_OBJECT_VISIT_COST = 1.0;
+    // Occupancy samples (one per second) between cell-size re-evaluations.
+    constexpr int GRID_RETUNE_INTERVAL = 30;
+    // A rebuild must cut the estimated query cost by at least this fraction.
+    constexpr double GRID_RETUNE_MIN_GAIN = 0.1;
 }
 
 #endif
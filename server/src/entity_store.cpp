@@ -0,0 +1,90 @@
+#include "entity_store.h"
+
+#include <stdexcept>
+
+EntityStore entity_store;
+
+const char *ObjectTypeName(ObjectType type) {
+    switch (type) {
+        case ObjectType::PLAYER: return "player";
+        case ObjectType::SNOWBALL: return "snowball";
+        default: return "unknown";
+    }
+}
+
+EntityStore::~EntityStore() {
+    for (auto &chunk : chunks_) delete chunk.load(std::memory_order_relaxed);
+}
+
+// Partition the calling thread allocates from.
+static thread_local uint32_t thread_partition = 0;
+
+EntityId EntityStore::Create() {
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    if (thread_partition >= partition_free_.size()) {
+        partition_free_.resize(thread_partition + 1);
+        partition_chunks_.resize(thread_partition + 1);
+    }
+
+    auto &free = partition_free_[thread_partition];
+    if (free.empty()) {
+        if (next_chunk_ == MAX_CHUNKS) throw std::length_error("entity store is full");
+        uint32_t chunk = next_chunk_++;
+        chunks_[chunk].store(new EntityChunk(), std::memory_order_release);
+        chunk_partition_[chunk] = thread_partition;
+        partition_chunks_[thread_partition].push_back(chunk);
+        // Hand out low slots first.
+        for (uint32_t slot = ENTITY_CHUNK_SIZE; slot-- > 0;) free.push_back((chunk << ENTITY_CHUNK_BITS) | slot);
+    }
+
+    uint32_t index = free.back();
+    free.pop_back();
+    return {index, ChunkOf(index).generations[SlotOf(index)].load(std::memory_order_relaxed)};
+}
+
+void EntityStore::Destroy(EntityId id) {
+    if (!Alive(id)) return;
+
+    auto &chunk = ChunkOf(id.index);
+    uint32_t slot = SlotOf(id.index);
+    chunk.names[slot].clear();
+    chunk.generations[slot].fetch_add(1, std::memory_order_release);
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    partition_free_[chunk_partition_[id.index >> ENTITY_CHUNK_BITS]].push_back(id.index);
+}
+
+bool EntityStore::Alive(EntityId id) const {
+    if (!id.Valid() || (id.index >> ENTITY_CHUNK_BITS) >= MAX_CHUNKS) return false;
+    EntityChunk *chunk = chunks_[id.index >> ENTITY_CHUNK_BITS].load(std::memory_order_acquire);
+    return chunk && chunk->generations[SlotOf(id.index)].load(std::memory_order_acquire) == id.generation;
+}
+
+uint32_t EntityStore::BindThreadPartition() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    thread_partition = next_partition_++;
+    return thread_partition;
+}
+
+uint32_t EntityStore::ThreadPartition() {
+    return thread_partition;
+}
+
+void EntityStore::PartitionChunks(uint32_t partition, std::vector<EntityChunk *> &out) {
+    out.clear();
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (partition >= partition_chunks_.size()) return;
+    for (uint32_t chunk : partition_chunks_[partition]) out.push_back(chunks_[chunk].load(std::memory_order_relaxed));
+}
+
+void EvaluatePositions(std::span<const EntityId> ids, long long current_time,
+                       std::span<double> xs, std::span<double> ys) {
+    for (size_t i = 0; i < ids.size(); i++) {
+        const EntityChunk &chunk = entity_store.ChunkOf(ids[i].index);
+        uint32_t slot = EntityStore::SlotOf(ids[i].index);
+        long long elapsed = current_time - chunk.time_updates[slot];
+        xs[i] = Extrapolate(chunk.types[slot], chunk.xs[slot], chunk.vxs[slot], elapsed);
+        ys[i] = Extrapolate(chunk.types[slot], chunk.ys[slot], chunk.vys[slot], elapsed);
+    }
+}
@@ -0,0 +1,219 @@
+#ifndef ENTITY_STORE_H
+#define ENTITY_STORE_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "constants.h"
+#include "tick_clock.h"
+
+// Compact tag for the object kinds the server knows about.
+enum class ObjectType : uint8_t {
+    UNKNOWN,
+    PLAYER,
+    SNOWBALL
+};
+
+// Name used for the type on the wire.
+const char *ObjectTypeName(ObjectType type);
+
+// Coordinate of an entity elapsed_ms after its last update. Snowballs move
+// linearly; everything else stays where it was last put. Written without
+// a branch so batched callers vectorize.
+inline double Extrapolate(ObjectType type, double pos, double vel, long long elapsed_ms) {
+    double moving = type == ObjectType::SNOWBALL;
+    return pos + moving * vel * (elapsed_ms / 1000.0);
+}
+
+// Server-assigned entity handle. The generation changes every time a slot
+// is reused, so a stale handle never matches the slot's new owner.
+struct EntityId {
+    static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+    uint32_t index = INVALID_INDEX;
+    uint32_t generation = 0;
+
+    bool Valid() const { return index != INVALID_INDEX; }
+    bool operator==(const EntityId &) const = default;
+};
+
+// 16.16 fixed-point number: range +-32768 at 1/65536 resolution, which
+// covers world coordinates, sizes and velocities in px/s.
+struct Fixed16 {
+    int32_t raw = 0;
+
+    Fixed16() = default;
+    Fixed16(double v)
+        : raw(static_cast<int32_t>(std::lround(std::clamp(v * 65536.0, double(INT32_MIN), double(INT32_MAX))))) {}
+    operator double() const { return raw / 65536.0; }
+};
+
+inline int32_t Saturate32(long long v) {
+    return static_cast<int32_t>(std::clamp<long long>(v, INT32_MIN, INT32_MAX));
+}
+
+// Millisecond timestamp stored as the low 32 bits of the tick clock. It
+// reads back as the time with those bits nearest TickClock::Latest(), so
+// the clock can wrap any number of times; only timestamps more than about
+// 24 days from the present come back wrong.
+class Tick32 {
+    uint32_t bits_ = 0;
+public:
+    Tick32() = default;
+    Tick32(long long ms) : bits_(static_cast<uint32_t>(ms)) {}
+    operator long long() const {
+        long long now = TickClock::Latest();
+        return now + static_cast<int32_t>(bits_ - static_cast<uint32_t>(now));
+    }
+};
+
+// Life length of an entity that never expires.
+constexpr long long ENTITY_NEVER_MS = static_cast<long long>(4e18);
+
+// Whether an entity whose life started elapsed ms ago has outlived it. A
+// start ahead of the clock counts as no time elapsed.
+inline bool LifeOver(long long elapsed, long long life_length) {
+    return std::max(elapsed, 0LL) > life_length;
+}
+
+// Millisecond duration stored in 32 bits. Durations of about 24 days or
+// more are stored as INT32_MAX and read back as ENTITY_NEVER_MS, so "never"
+// survives the round trip.
+class Span32 {
+    int32_t ms_ = 0;
+public:
+    Span32() = default;
+    Span32(long long ms) : ms_(Saturate32(ms)) {}
+    operator long long() const { return ms_ == INT32_MAX ? ENTITY_NEVER_MS : ms_; }
+};
+
+// Storage types of the hot entity components. The defaults are full width;
+// build with one of
+//   -DENTITY_COORD_FLOAT32   positions, velocities and sizes as float
+//   -DENTITY_COORD_FIXED16   ... as 16.16 fixed point
+//   -DENTITY_TICKS32         timestamps and life lengths in 32 bits
+// to shrink the per-entity record. Components convert to double and long
+// long on read, so only the storage changes.
+#if defined(ENTITY_COORD_FLOAT32)
+using EntityCoord = float;
+#elif defined(ENTITY_COORD_FIXED16)
+using EntityCoord = Fixed16;
+#else
+using EntityCoord = double;
+#endif
+
+#if defined(ENTITY_TICKS32)
+using EntityTime = Tick32;
+using EntityDuration = Span32;
+#else
+using EntityTime = long long;
+using EntityDuration = long long;
+#endif
+
+#if defined(ENTITY_COORD_FLOAT32) || defined(ENTITY_COORD_FIXED16) || defined(ENTITY_TICKS32)
+#define ENTITY_COMPACT_STATE 1
+#endif
+
+// Components of ENTITY_CHUNK_SIZE consecutive entity slots, stored as one
+// array per field so passes over a component walk contiguous memory.
+constexpr uint32_t ENTITY_CHUNK_BITS = 12;
+constexpr uint32_t ENTITY_CHUNK_SIZE = 1u << ENTITY_CHUNK_BITS;
+
+struct EntityChunk {
+    std::array<std::atomic<uint32_t>, ENTITY_CHUNK_SIZE> generations{};
+
+    // Kinematics: position at time_updates[i], velocity in units per second.
+    std::array<EntityCoord, ENTITY_CHUNK_SIZE> xs, ys, vxs, vys, sizes;
+    std::array<EntityTime, ENTITY_CHUNK_SIZE> time_updates;
+    std::array<EntityDuration, ENTITY_CHUNK_SIZE> life_lengths;
+
+    std::array<int, ENTITY_CHUNK_SIZE> healths;
+    // Grid cell the entity is currently bucketed in.
+    std::array<int, ENTITY_CHUNK_SIZE> rows, cols;
+    std::array<ObjectType, ENTITY_CHUNK_SIZE> types;
+    // Read by the collision pass while the owner may write them.
+    std::array<std::atomic<int>, ENTITY_CHUNK_SIZE> damages{};
+    std::array<std::atomic<EntityId>, ENTITY_CHUNK_SIZE> owners{};
+    std::array<std::atomic<uint32_t>, ENTITY_CHUNK_SIZE> team_masks{};
+    // Written by the collision pass as well as by the owner.
+    std::array<std::atomic<bool>, ENTITY_CHUNK_SIZE> dead{};
+    // Set by the owning worker while the entity takes part in its
+    // per-tick kinematics sweep.
+    std::array<bool, ENTITY_CHUNK_SIZE> simulated;
+
+    // Client-facing string IDs; only the protocol reads them.
+    std::array<std::string, ENTITY_CHUNK_SIZE> names;
+};
+
+// Allocates entity handles and owns every entity's components.
+//
+// Chunks are never moved or freed, so a live entity's components can be
+// read and written without the allocation lock; as with the objects they
+// replace, each entity is written by its owning worker.
+//
+// Chunks belong to partitions. A thread allocates from the partition it is
+// bound to (partition 0 unless it called BindThreadPartition), so the
+// entities a worker creates are packed into chunks only it allocates from,
+// and its per-tick passes can sweep those chunks directly.
+class EntityStore {
+    static constexpr uint32_t MAX_CHUNKS = constants::MAX_ENTITIES / ENTITY_CHUNK_SIZE;
+
+    // Guards allocation: the partition tables and next_chunk_.
+    std::mutex mtx_;
+    uint32_t next_chunk_ = 0;
+    uint32_t next_partition_ = 1;
+    std::vector<std::vector<uint32_t>> partition_chunks_, partition_free_;
+    std::array<uint32_t, MAX_CHUNKS> chunk_partition_{};
+    std::array<std::atomic<EntityChunk *>, MAX_CHUNKS> chunks_{};
+
+public:
+    EntityStore() = default;
+    ~EntityStore();
+
+    EntityStore(const EntityStore &) = delete;
+    EntityStore &operator=(const EntityStore &) = delete;
+
+    // Allocates from the calling thread's partition. Throws
+    // std::length_error once all MAX_ENTITIES slots belong to chunks and the
+    // partition has none left.
+    EntityId Create();
+    // May run on any thread; the slot returns to its chunk's partition.
+    void Destroy(EntityId id);
+
+    bool Alive(EntityId id) const;
+
+    // Gives the calling thread a partition of its own and returns it.
+    uint32_t BindThreadPartition();
+    static uint32_t ThreadPartition();
+
+    // Partition of the thread that created the entity at index.
+    uint32_t PartitionOf(uint32_t index) const { return chunk_partition_[index >> ENTITY_CHUNK_BITS]; }
+
+    // Replaces out with the chunks of a partition.
+    void PartitionChunks(uint32_t partition, std::vector<EntityChunk *> &out);
+
+    // The chunk and slot holding the components of the entity at index.
+    EntityChunk &ChunkOf(uint32_t index) const {
+        return *chunks_[index >> ENTITY_CHUNK_BITS].load(std::memory_order_acquire);
+    }
+    static uint32_t SlotOf(uint32_t index) { return index & (ENTITY_CHUNK_SIZE - 1); }
+
+    const std::string &Name(EntityId id) const { return ChunkOf(id.index).names[SlotOf(id.index)]; }
+};
+
+extern EntityStore entity_store;
+
+// Writes the positions of the (live) entities in ids at current_time to
+// xs and ys, which must be at least as long as ids.
+void EvaluatePositions(std::span<const EntityId> ids, long long current_time,
+                       std::span<double> xs, std::span<double> ys);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef FUNCTION_REF_H
+#define FUNCTION_REF_H
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// Non-owning reference to a callable. Unlike std::function it never
+// allocates, so it is cheap to pass into hot query paths. The referenced
+// callable must outlive the FunctionRef.
+template <typename Fn>
+class FunctionRef;
+
+template <typename R, typename... Args>
+class FunctionRef<R(Args...)> {
+public:
+    template <typename F,
+              typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, FunctionRef> &&
+                                          std::is_invocable_r_v<R, F &, Args...>>>
+    FunctionRef(F &&f)
+        : obj_(const_cast<void *>(static_cast<const void *>(std::addressof(f)))),
+          call_([](void *obj, Args... args) -> R {
+              return (*static_cast<std::remove_reference_t<F> *>(obj))(std::forward<Args>(args)...);
+          }) {}
+
+    R operator()(Args... args) const { return call_(obj_, std::forward<Args>(args)...); }
+
+private:
+    void *obj_;
+    R (*call_)(void *, Args...);
+};
+
+#endif
@@ -4,20 +4,15 @@
 
 // Returns true if the object has expired based on its life length.
 bool GameObject::Expired(long long current_time) {
-    long long elapsed_time = current_time - get_time_update();
-    return (elapsed_time > get_life_length());
+    return LifeOver(current_time - get_time_update(), get_life_length());
 }
 
 // Checks for a collision with another GameObject.
 // If a collision occurs, marks the object as dead and returns true.
-bool GameObject::Collide(std::shared_ptr<GameObject> obj) {
+bool GameObject::Collide(std::shared_ptr<GameObject> obj, long long current_time) {
     if (get_is_dead())
         return false;
 
-    auto now = std::chrono::system_clock::now();
-    long long current_time = std::chrono::duration_cast<std::chrono::milliseconds>(
-        now.time_since_epoch()).count();
-    
     double x_diff = obj->get_cur_x(current_time) - get_cur_x(current_time);
     double y_diff = obj->get_cur_y(current_time) - get_cur_y(current_time);
     double distance_square = x_diff * x_diff + y_diff * y_diff;
@@ -31,30 +26,63 @@ bool GameObject::Collide(std::shared_ptr<GameObject> obj) {
 }
 
 // Applies damage to the object and marks it as dead if health reaches zero.
-void GameObject::Hurt(uWS::WebSocket<false, true, PointerToPlayer>* ws, int damage) {
+void GameObject::Hurt(uWS::WebSocket<false, true, PointerToPlayer>* ws, int damage, long long current_time) {
     set_health(std::max(get_health() - damage, 0));
     if (get_health() == 0) { set_is_dead(true); }
-    SendMessageToClient(ws, "hit");
+    SendMessageToClient(ws, "hit", current_time);
 }
 
-// Sends a message to the client with the object's current state.
-void GameObject::SendMessageToClient(uWS::WebSocket<false, true, PointerToPlayer>* ws, std::string type) {
-    auto now = std::chrono::system_clock::now();
-    long long current_time = std::chrono::duration_cast<std::chrono::milliseconds>(
-        now.time_since_epoch()).count();
-    
-    json data = {
-        {"id", get_id()},
+// Sends the object's state in the client's protocol.
+void GameObject::SendMessageToClient(uWS::WebSocket<false, true, PointerToPlayer>* ws, std::string type,
+                                     long long current_time) {
+    auto *client = ws->getUserData();
+    if (client->protocol) {
+        WireWriter frame;
+        frame.PutU8(WIRE_VERSION);
+        EncodeState(frame, client->named, type == "hit" ? WireMessage::HIT : WireMessage::MOVEMENT, current_time);
+        ws->send(frame.get_data(), uWS::OpCode::BINARY);
+        return;
+    }
+    ws->send(StateJson(type, current_time).dump(), uWS::OpCode::TEXT);
+}
+
+// Positions are taken at current_time; the expiry date goes out in wall-clock time.
+json GameObject::StateJson(const std::string &type, long long current_time) const {
+    return {
+        {"id", get_name()},
         {"messageType", type},
-        {"objectType", get_type()},
+        {"objectType", ObjectTypeName(get_type())},
         {"position", {{"x", get_cur_x(current_time)}, {"y", get_cur_y(current_time)}}},
         {"velocity", {{"x", get_vx()}, {"y", get_vy()}}},
         {"size", get_size()},
         {"charging", get_charging()},
-        {"expireDate", current_time + get_life_length()},
+        {"expireDate", TickClock::ToWall(current_time) + get_life_length()},
         {"isDead", get_is_dead()},
         {"newHealth", get_health()}
     };
+}
+
+void GameObject::EncodeState(WireWriter &out, std::unordered_set<uint64_t> &named, WireMessage message,
+                             long long current_time) const {
+    if (named.insert(WireKey(id_)).second) EncodeName(out);
+    EncodeStateRecord(out, message, current_time);
+}
+
+void GameObject::EncodeName(WireWriter &out) const {
+    PutNameRecord(out, id_.index, get_name());
+}
 
-    ws->send(data.dump(), uWS::OpCode::TEXT);
+void GameObject::EncodeStateRecord(WireWriter &out, WireMessage message, long long current_time) const {
+    WireState state;
+    state.index = id_.index;
+    state.flags = static_cast<uint8_t>(get_type()) | (get_charging() ? WIRE_CHARGING : 0) |
+                  (get_is_dead() ? WIRE_DEAD : 0);
+    state.x = static_cast<float>(get_cur_x(current_time));
+    state.y = static_cast<float>(get_cur_y(current_time));
+    state.vx = static_cast<float>(get_vx());
+    state.vy = static_cast<float>(get_vy());
+    state.size = static_cast<float>(get_size());
+    state.life_length = WireLifeLength(get_life_length());
+    state.health = WireHealth(get_health());
+    PutStateRecord(out, message, state);
 }
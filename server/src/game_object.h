@@ -2,110 +2,164 @@
 #define GAME_OBJECT_H
 
 #include <string>
+#include <cstdint>
 #include <memory>
 #include <chrono>
+#include <unordered_set>
 #include "nlohmann/json.hpp"
 #include <uWebSockets/App.h>
 
+#include "entity_store.h"
+#include "wire.h"
+
 using json = nlohmann::json;
 
 class Player;
 
+// Inclusive rectangle of cells in a grid with the given cell size. The
+// default range is empty.
+struct CellRange {
+    int cell_size = 0;
+    int lower_row = 0, upper_row = -1;
+    int left_col = 0, right_col = -1;
+
+    bool Contains(int row, int col) const {
+        return row >= lower_row && row <= upper_row && col >= left_col && col <= right_col;
+    }
+    bool operator==(const CellRange &) const = default;
+};
+
 struct PointerToPlayer {
     std::shared_ptr<Player> player;
+    // Wire protocol version agreed at join; 0 means JSON.
+    uint8_t protocol = 0;
+    // Entities (see WireKey) this client has been sent a NAME record for.
+    std::unordered_set<uint64_t> named;
+    // Cells whose topics (see CellTopic) a binary client is subscribed to.
+    CellRange view;
 };
 
+// Identifies an entity for as long as its slot is not reused.
+inline uint64_t WireKey(EntityId id) { return (static_cast<uint64_t>(id.generation) << 32) | id.index; }
+
+// A game object is a view over one entity's components in entity_store;
+// it owns the entity and frees its slot when destroyed.
 class GameObject {
 public:
     // Constructors and destructor
-    GameObject()
-        : type_("unknown"), id_("unknown"),
-          x_(0), y_(0), vx_(0), vy_(0), size_(1),
-          row_(0), col_(0), health_(100), damage_(0),
-          time_update_(0), life_length_(1000),
-          is_dead_(false) {}
-
-    GameObject(std::string id, std::string type)
-        : type_(std::move(type)), id_(std::move(id)),
-          x_(0), y_(0), vx_(0), vy_(0), size_(1),
-          row_(0), col_(0), health_(100), damage_(0),
-          time_update_(0), life_length_(1000),
-          is_dead_(false) {}
-
-    virtual ~GameObject() = default;
+    GameObject() : GameObject(ObjectType::UNKNOWN, "unknown") {}
+
+    GameObject(ObjectType type, std::string name)
+        : id_(entity_store.Create()),
+          chunk_(&entity_store.ChunkOf(id_.index)), slot_(EntityStore::SlotOf(id_.index)) {
+        set_type(type);
+        set_name(std::move(name));
+        set_x(0); set_y(0); set_vx(0); set_vy(0); set_size(1);
+        set_row(0); set_col(0); set_health(100); set_damage(0);
+        set_time_update(0); set_life_length(1000);
+        set_is_dead(false); set_simulated(false); set_owner(EntityId()); set_team_mask(0);
+    }
+
+    GameObject(const GameObject &) = delete;
+    GameObject &operator=(const GameObject &) = delete;
+
+    virtual ~GameObject() { entity_store.Destroy(id_); }
 
     // Inline Getters
-    inline std::string get_type() const { return type_; }
-    inline std::string get_id() const { return id_; }
-    inline double get_x() const { return x_; }
-    inline double get_y() const { return y_; }
-    inline double get_vx() const { return vx_; }
-    inline double get_vy() const { return vy_; }
-    inline double get_size() const { return size_; }
-    inline int get_row() const { return row_; }
-    inline int get_col() const { return col_; }
-    inline int get_health() const { return health_; }
-    inline int get_damage() const { return damage_; }
-    inline long long get_time_update() const { return time_update_; }
-    inline long long get_life_length() const { return life_length_; }
-    inline bool get_is_dead() const { return is_dead_; }
-
-    // Virtual functions for current position calculations
-    virtual inline double get_cur_x(long long /*current_time*/) const { return x_; }
-    virtual inline double get_cur_y(long long /*current_time*/) const { return y_; }
+    inline EntityId get_id() const { return id_; }
+    // Client-facing ID; only needed when talking to clients.
+    inline const std::string &get_name() const { return chunk_->names[slot_]; }
+    inline ObjectType get_type() const { return chunk_->types[slot_]; }
+    inline double get_x() const { return chunk_->xs[slot_]; }
+    inline double get_y() const { return chunk_->ys[slot_]; }
+    inline double get_vx() const { return chunk_->vxs[slot_]; }
+    inline double get_vy() const { return chunk_->vys[slot_]; }
+    inline double get_size() const { return chunk_->sizes[slot_]; }
+    inline int get_row() const { return chunk_->rows[slot_]; }
+    inline int get_col() const { return chunk_->cols[slot_]; }
+    inline int get_health() const { return chunk_->healths[slot_]; }
+    inline int get_damage() const { return chunk_->damages[slot_].load(std::memory_order_relaxed); }
+    inline long long get_time_update() const { return chunk_->time_updates[slot_]; }
+    inline long long get_life_length() const { return chunk_->life_lengths[slot_]; }
+    inline bool get_is_dead() const { return chunk_->dead[slot_].load(std::memory_order_relaxed); }
+    inline bool get_simulated() const { return chunk_->simulated[slot_]; }
+    // Entity that created this object (e.g. a snowball's thrower), if any.
+    inline EntityId get_owner() const { return chunk_->owners[slot_].load(std::memory_order_relaxed); }
+    // One bit per team; objects sharing a bit are allies. 0 = no team.
+    inline uint32_t get_team_mask() const { return chunk_->team_masks[slot_].load(std::memory_order_relaxed); }
+
+    // Position at current_time, dispatched on the type tag (see Extrapolate).
+    inline double get_cur_x(long long current_time) const {
+        return Extrapolate(get_type(), get_x(), get_vx(), current_time - get_time_update());
+    }
+    inline double get_cur_y(long long current_time) const {
+        return Extrapolate(get_type(), get_y(), get_vy(), current_time - get_time_update());
+    }
 
     // Inline Setters
-    inline void set_type(std::string type) { type_ = std::move(type); }
-    inline void set_id(std::string id) { id_ = std::move(id); }
-    inline void set_x(double x) { x_ = x; }
-    inline void set_y(double y) { y_ = y; }
-    inline void set_vx(double vx) { vx_ = vx; }
-    inline void set_vy(double vy) { vy_ = vy; }
-    inline void set_size(double size) { size_ = size; }
-    inline void set_row(int row) { row_ = row; }
-    inline void set_col(int col) { col_ = col; }
-    inline void set_health(int health) { health_ = health; }
-    inline void set_damage(int damage) { damage_ = damage; }
-    inline void set_time_update(long long time_update) { time_update_ = time_update; }
-    inline void set_life_length(long long life_length) { life_length_ = life_length; }
-    inline void set_is_dead(bool is_dead) { is_dead_ = is_dead; }
+    inline void set_name(std::string name) { chunk_->names[slot_] = std::move(name); }
+    inline void set_type(ObjectType type) { chunk_->types[slot_] = type; }
+    inline void set_x(double x) { chunk_->xs[slot_] = x; }
+    inline void set_y(double y) { chunk_->ys[slot_] = y; }
+    inline void set_vx(double vx) { chunk_->vxs[slot_] = vx; }
+    inline void set_vy(double vy) { chunk_->vys[slot_] = vy; }
+    inline void set_size(double size) { chunk_->sizes[slot_] = size; }
+    inline void set_row(int row) { chunk_->rows[slot_] = row; }
+    inline void set_col(int col) { chunk_->cols[slot_] = col; }
+    inline void set_health(int health) { chunk_->healths[slot_] = health; }
+    inline void set_damage(int damage) { chunk_->damages[slot_].store(damage, std::memory_order_relaxed); }
+    inline void set_time_update(long long time_update) { chunk_->time_updates[slot_] = time_update; }
+    inline void set_life_length(long long life_length) { chunk_->life_lengths[slot_] = life_length; }
+    inline void set_is_dead(bool is_dead) { chunk_->dead[slot_].store(is_dead, std::memory_order_relaxed); }
+    inline void set_simulated(bool simulated) { chunk_->simulated[slot_] = simulated; }
+    inline void set_owner(EntityId owner) { chunk_->owners[slot_].store(owner, std::memory_order_relaxed); }
+    inline void set_team_mask(uint32_t team_mask) {
+        chunk_->team_masks[slot_].store(team_mask, std::memory_order_relaxed);
+    }
+
+    // Whether this object's hits count against target: never against the
+    // entity that threw it, and never against a teammate (shared team bit).
+    inline bool CanHurt(const GameObject &target) const {
+        return get_owner() != target.get_id() && !(get_team_mask() & target.get_team_mask());
+    }
 
     // Default implementation of get_charging; can be overridden by derived classes.
     virtual inline bool get_charging() const { return false; }
 
     // Other member functions (implementation can be moved to a .cpp file if needed)
     bool Expired(long long current_time);
-    bool Collide(std::shared_ptr<GameObject> obj);
-    void Hurt(uWS::WebSocket<false, true, PointerToPlayer>* ws, int damage);
-    virtual void SendMessageToClient(uWS::WebSocket<false, true, PointerToPlayer>* ws, std::string type);
+    // Times are on the tick clock (see TickClock).
+    bool Collide(std::shared_ptr<GameObject> obj, long long current_time);
+    void Hurt(uWS::WebSocket<false, true, PointerToPlayer>* ws, int damage, long long current_time);
+    virtual void SendMessageToClient(uWS::WebSocket<false, true, PointerToPlayer>* ws, std::string type,
+                                     long long current_time);
+
+    // The object's state as a JSON message, and as a STATE record preceded
+    // by a NAME record unless named already holds the entity.
+    json StateJson(const std::string &type, long long current_time) const;
+    void EncodeState(WireWriter &out, std::unordered_set<uint64_t> &named, WireMessage message,
+                     long long current_time) const;
+
+    // The two records of EncodeState on their own.
+    void EncodeName(WireWriter &out) const;
+    void EncodeStateRecord(WireWriter &out, WireMessage message, long long current_time) const;
 
 protected:
-    std::string type_, id_;
-    double x_, y_, vx_, vy_, size_;
-    int row_, col_, health_, damage_;
-    long long time_update_, life_length_;
-    bool is_dead_;
+    EntityId id_;
+    // Where this entity's components live; fixed for the object's lifetime.
+    EntityChunk *chunk_;
+    uint32_t slot_;
 };
 
 class Player : public GameObject {
-    // Additional Player-specific members and methods can be declared here.
+public:
+    Player() : GameObject(ObjectType::PLAYER, "unknown") {}
 };
 
 class Snowball : public GameObject {
 public:
-    Snowball(const std::string& id, const std::string& type)
-        : GameObject(id, type), charging_(false) {}
-
-    // Override to compute current position based on elapsed time.
-    virtual double get_cur_x(long long current_time) const override {
-        long long elapsed_time = current_time - get_time_update();
-        return get_x() + get_vx() * (elapsed_time / 1000.0);
-    }
-
-    virtual double get_cur_y(long long current_time) const override {
-        long long elapsed_time = current_time - get_time_update();
-        return get_y() + get_vy() * (elapsed_time / 1000.0);
-    }
+    explicit Snowball(std::string name)
+        : GameObject(ObjectType::SNOWBALL, std::move(name)), charging_(false) {}
 
     // Override get_charging to return the snowball's charging state.
     inline bool get_charging() const override { return charging_; }
@@ -1,79 +1,318 @@
-#include "grid.h"
+#include "grid_impl.h"
 
 
-Grid::Grid(int height, int width, int cell_size)
-    : height_(height), width_(width), cell_size_(cell_size),
+Grid::Grid(int height, int width, int cell_size, GridMode mode)
+    : mode_(mode), height_(height), width_(width), cell_size_(cell_size),
       rows_((height_ - 1) / cell_size_ + 1), cols_((width_ - 1) / cell_size_ + 1),
-      cells_(rows_) {
-          for (auto &row: cells_) {
-              for (int i = 0; i < cols_; i++) {
-                  row.push_back(std::make_unique<Cell>());
-              }
-          }
-}
+      cells_(mode_ == GridMode::DENSE ? static_cast<size_t>(rows_) * cols_ : 0) {}
 
 Grid::~Grid() {}
 
 void Grid::Insert(std::shared_ptr<GameObject> obj) {
-    int row = static_cast<int>(obj->get_y()) / cell_size_;
-    int col = static_cast<int>(obj->get_x()) / cell_size_;
+    InsertImpl(Geometry(), std::move(obj));
+}
+
+void Grid::Remove(std::shared_ptr<GameObject> obj) {
+    RemoveImpl(Geometry(), obj);
+}
 
-    if (row >= rows_ || col >= cols_ || row < 0 || col < 0) return;
+void Grid::Update(std::shared_ptr<GameObject> obj, long long current_time) {
+    UpdateImpl(Geometry(), obj, current_time);
+}
 
-    obj->set_row(row);
-    obj->set_col(col);
+void Grid::UpdateMany(std::span<const std::shared_ptr<GameObject>> objs, long long current_time) {
+    UpdateManyImpl(Geometry(), objs, current_time);
+}
 
-    cells_[row][col]->Insert(obj);
+void Grid::ForEach(double lower_y, double upper_y, double left_x, double right_x,
+                   ObjectVisitor visit) {
+    ForEachImpl(Geometry(), lower_y, upper_y, left_x, right_x, visit);
 }
 
+void Grid::ForEachOverlapping(double lower_y, double upper_y, double left_x, double right_x,
+                              long long current_time, ObjectVisitor visit) {
+    ForEachOverlappingImpl(Geometry(), lower_y, upper_y, left_x, right_x, current_time, visit);
+}
 
-void Grid::Remove(std::shared_ptr<GameObject> obj) {
-    int row = obj->get_row();
-    int col = obj->get_col();
+void Grid::ForEachInRadius(double x, double y, double radius, long long current_time,
+                           ObjectVisitor visit) {
+    ForEachInRadiusImpl(Geometry(), x, y, radius, current_time, visit);
+}
 
-    if (row >= rows_ || col >= cols_ || row < 0 || col < 0) return;
+void Grid::Nearest(double x, double y, size_t k, double max_radius, long long current_time,
+                   std::vector<std::shared_ptr<GameObject>> &out) {
+    NearestImpl(Geometry(), x, y, k, max_radius, current_time, out);
+}
 
-    cells_[row][col]->Remove(obj);
+void Grid::ForEachContact(long long current_time, ContactVisitor visit) {
+    ForEachContactImpl(Geometry(), current_time, visit);
 }
 
-void Grid::Update(std::shared_ptr<GameObject> obj, long long current_time) {
-    int old_row = obj->get_row();
-    int old_col = obj->get_col();
-    int cur_y = static_cast<int>(obj->get_cur_y(current_time));
-    int cur_x = static_cast<int>(obj->get_cur_x(current_time));
-    int new_row = cur_y / cell_size_;
-    int new_col = cur_x / cell_size_;
-
-    if (new_row < 0 || new_col < 0 || new_row >= rows_ || new_col >= cols_) return; 
-
-    if ((old_row != new_row) || (old_col != new_col)) {
-        Remove(obj);
-        obj->set_row(new_row); obj->set_col(new_col);
-        obj->set_x(cur_x); obj->set_y(cur_y);
-        obj->set_life_length(obj->get_life_length() - (current_time - obj->get_time_update()));
-        obj->set_time_update(current_time);
-        Insert(obj);
+void Grid::ForEachCellBlob(double lower_y, double upper_y, double left_x, double right_x,
+                           CellBlobVisitor visit) {
+    ForEachCellBlobImpl(Geometry(), lower_y, upper_y, left_x, right_x, visit);
+}
+
+uint64_t Grid::CellKey(int row, int col) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(row)) << 32) | static_cast<uint32_t>(col);
+}
+
+// Looks up a sparse cell; the caller holds sparse_mtx_.
+Cell *Grid::FindSparseCell(int row, int col) {
+    auto it = sparse_cells_.find(CellKey(row, col));
+    return it == sparse_cells_.end() ? nullptr : it->second.get();
+}
+
+// Grows range to cover cell (row, col).
+static void ExtendRange(CellRange &range, int row, int col) {
+    if (range.upper_row < range.lower_row) {
+        range.lower_row = range.upper_row = row;
+        range.left_col = range.right_col = col;
+        return;
     }
+    range.lower_row = std::min(range.lower_row, row);
+    range.upper_row = std::max(range.upper_row, row);
+    range.left_col = std::min(range.left_col, col);
+    range.right_col = std::max(range.right_col, col);
 }
 
+// Finds or allocates a sparse cell; the caller holds sparse_mtx_ exclusively.
+Cell &Grid::AllocateSparseCell(int row, int col) {
+    auto &cell = sparse_cells_[CellKey(row, col)];
+    if (!cell) {
+        cell = std::make_unique<Cell>();
+        ExtendRange(sparse_bounds_, row, col);
+    }
+    return *cell;
+}
 
-std::vector<std::shared_ptr<GameObject>> Grid::Search(double lower_y, double upper_y, 
-                                                      double left_x, double right_x) { 
-    int lower_row = static_cast<int>(lower_y) / cell_size_;
-    int upper_row = static_cast<int>(upper_y) / cell_size_;
-    int left_col = static_cast<int>(left_x) / cell_size_;
-    int right_col = static_cast<int>(right_x) / cell_size_;
+// Rebases a moving object onto its current position so the new cell's
+// record extrapolates from there.
+void Grid::Rebase(GameObject &obj, int cur_x, int cur_y, int row, int col, long long current_time) {
+    obj.set_row(row); obj.set_col(col);
+    obj.set_x(cur_x); obj.set_y(cur_y);
+    obj.set_life_length(obj.get_life_length() - (current_time - obj.get_time_update()));
+    obj.set_time_update(current_time);
+}
 
-    std::vector<std::shared_ptr<GameObject>> all;
+// Moves obj's record between cells. The caller holds both cell locks, so
+// readers see the object in exactly one of the two cells.
+void Grid::Relocate(Cell *from, Cell &to, const std::shared_ptr<GameObject> &obj,
+                    int cur_x, int cur_y, int row, int col, long long current_time) {
+    if (from) {
+        int i = from->IndexOf(obj.get());
+        if (i >= 0) from->Erase(i);
+    }
+    Rebase(*obj, cur_x, cur_y, row, col, current_time);
+    if (to.IndexOf(obj.get()) < 0) to.Append(obj);
+}
+
+void Grid::RaiseAtomic(std::atomic<double> &value, double to) {
+    double cur = value.load();
+    while (to > cur && !value.compare_exchange_weak(cur, to)) {}
+}
+
+void Grid::RaiseMaxSize(double size) {
+    RaiseAtomic(recent_max_size_, size);
+}
+
+// Moves the extents stored during the previous pass into scanned_max_size_
+// before clearing them, so MaxSize never drops them while the pass runs.
+void Grid::BeginMaxSizeScan() {
+    double recent = recent_max_size_.load();
+    do {
+        RaiseAtomic(scanned_max_size_, recent);
+    } while (!recent_max_size_.compare_exchange_weak(recent, 0.0));
+}
+
+double Grid::MaxSize() const {
+    return std::max(scanned_max_size_.load(), recent_max_size_.load());
+}
+
+void Grid::SearchOverlapping(double lower_y, double upper_y, double left_x, double right_x,
+                             long long current_time, std::vector<std::shared_ptr<GameObject>> &out) {
+    out.clear();
+    ForEachOverlapping(lower_y, upper_y, left_x, right_x, current_time,
+                       [&out](const std::shared_ptr<GameObject> &obj) { out.push_back(obj); });
+}
+
+void Grid::SearchRadius(double x, double y, double radius, long long current_time,
+                        std::vector<std::shared_ptr<GameObject>> &out) {
+    out.clear();
+    ForEachInRadius(x, y, radius, current_time,
+                    [&out](const std::shared_ptr<GameObject> &obj) { out.push_back(obj); });
+}
+
+void Grid::EncodeBlobs(long long current_time, CellBlobVisitor visit) {
+    thread_local std::unordered_set<uint64_t> previous;
+    // Swapped with each cell's blob, so buffers are reused across cells and ticks.
+    thread_local CellBlob next;
+
+    // The pass visits every cell anyway, so it also recomputes the extent
+    // bound; objects that shrank or left stop widening queries.
+    BeginMaxSizeScan();
+    double max_size = 0;
 
-    for (int r = lower_row; r <= upper_row; r++) {
-        for (int c = left_col; c <= right_col; c++) {
-            if (r >= rows_ || c >= cols_ || r < 0 || c < 0) continue;  // Boundary check
-            std::shared_lock<std::shared_mutex> lock(*(cells_[r][c]->mtx));
-            auto& cell_objs = cells_[r][c]->objects;
-            all.insert(all.end(), cell_objs.begin(), cell_objs.end());
+    auto encode = [&](int row, int col, Cell &cell) {
+        {
+            // Encode from the cell's arrays, which the owners only write
+            // under this lock. Names are fixed while an object is in the grid.
+            auto lock = cell.LockShared();
+            max_size = std::max(max_size, cell.max_size);
+            if (cell.Size() == 0 && cell.blob.ids.empty()) return;
+            previous.clear();
+            for (EntityId id : cell.blob.ids) previous.insert(WireKey(id));
+
+            next.ids.clear();
+            next.names.resize(cell.Size());
+            next.arrivals.Clear();
+            next.records.Clear();
+            for (size_t i = 0; i < cell.Size(); i++) {
+                const GameObject &obj = *cell.handles[i];
+                EntityId id = obj.get_id();
+                next.ids.push_back(id);
+                next.names[i] = obj.get_name();
+                if (!previous.count(WireKey(id))) PutNameRecord(next.arrivals, id.index, next.names[i]);
+
+                WireState state;
+                state.index = id.index;
+                state.flags = static_cast<uint8_t>(cell.types[i]) | (cell.charging[i] ? WIRE_CHARGING : 0) |
+                              (obj.get_is_dead() ? WIRE_DEAD : 0);
+                double x, y;
+                cell.PositionAt(i, current_time, x, y);
+                state.x = static_cast<float>(x);
+                state.y = static_cast<float>(y);
+                state.vx = static_cast<float>(cell.vxs[i]);
+                state.vy = static_cast<float>(cell.vys[i]);
+                state.size = static_cast<float>(cell.sizes[i]);
+                state.life_length = WireLifeLength(cell.life_lengths[i]);
+                state.health = WireHealth(cell.healths[i]);
+                PutStateRecord(next.records, WireMessage::MOVEMENT, state);
+            }
+        }
+
+        auto lock = cell.Lock();
+        std::swap(cell.blob, next);
+        if (!cell.blob.ids.empty() || !previous.empty()) visit(row, col, cell.blob);
+    };
+
+    if (mode_ == GridMode::DENSE) {
+        for (int r = 0; r < rows_; r++) {
+            for (int c = 0; c < cols_; c++) encode(r, c, DenseCell(r, c));
+        }
+    } else {
+        std::shared_lock<std::shared_mutex> lock(sparse_mtx_);
+        for (auto &[key, cell] : sparse_cells_) {
+            encode(static_cast<int32_t>(key >> 32), static_cast<int32_t>(key & 0xffffffffu), *cell);
+        }
+    }
+    scanned_max_size_.store(max_size);
+}
+
+CellRange Grid::CellsIn(double lower_y, double upper_y, double left_x, double right_x) const {
+    DynamicGeometry geo = Geometry();
+    CellRange range{cell_size_, geo.RowOf(lower_y), geo.RowOf(upper_y), geo.ColOf(left_x), geo.ColOf(right_x)};
+    if (!geo.Sparse()) {
+        range.lower_row = std::max(range.lower_row, 0);
+        range.upper_row = std::min(range.upper_row, rows_ - 1);
+        range.left_col = std::max(range.left_col, 0);
+        range.right_col = std::min(range.right_col, cols_ - 1);
+    }
+    return range;
+}
+
+void Grid::ForEachPosition(PositionVisitor visit) {
+    auto visit_cell = [&visit](Cell &cell) {
+        auto lock = cell.LockShared();
+        for (size_t i = 0; i < cell.Size(); i++) visit(cell.xs[i], cell.ys[i]);
+    };
+
+    if (mode_ == GridMode::DENSE) {
+        for (auto &cell : cells_) visit_cell(cell);
+        return;
+    }
+
+    std::shared_lock<std::shared_mutex> lock(sparse_mtx_);
+    for (auto &entry : sparse_cells_) visit_cell(*entry.second);
+}
+
+void Grid::CollectCounters(std::vector<CellCounters> &out) {
+    auto collect = [&out](int row, int col, Cell &cell) {
+        size_t objects;
+        {
+            std::shared_lock<std::shared_mutex> lock(cell.mtx);
+            objects = cell.Size();
+        }
+        out.push_back({row, col, objects,
+                       cell.lock_acquisitions.load(std::memory_order_relaxed),
+                       cell.contended_acquisitions.load(std::memory_order_relaxed),
+                       cell.lock_wait_ns.load(std::memory_order_relaxed)});
+    };
+
+    if (mode_ == GridMode::DENSE) {
+        for (int r = 0; r < rows_; r++) {
+            for (int c = 0; c < cols_; c++) collect(r, c, DenseCell(r, c));
         }
+        return;
     }
 
+    std::shared_lock<std::shared_mutex> lock(sparse_mtx_);
+    for (auto &[key, cell] : sparse_cells_) {
+        collect(static_cast<int32_t>(key >> 32), static_cast<int32_t>(key & 0xffffffffu), *cell);
+    }
+}
+
+void Grid::ResetCounters() {
+    auto reset = [](Cell &cell) {
+        cell.lock_acquisitions.store(0, std::memory_order_relaxed);
+        cell.contended_acquisitions.store(0, std::memory_order_relaxed);
+        cell.lock_wait_ns.store(0, std::memory_order_relaxed);
+    };
+
+    if (mode_ == GridMode::DENSE) {
+        for (auto &cell : cells_) reset(cell);
+        return;
+    }
+
+    std::shared_lock<std::shared_mutex> lock(sparse_mtx_);
+    for (auto &entry : sparse_cells_) reset(*entry.second);
+}
+
+void Grid::Compact() {
+    if (mode_ == GridMode::DENSE) return;
+
+    // Every cell user holds sparse_mtx_, so under the write lock no cell is in use.
+    // A cell whose blob still lists objects waits for EncodeBlobs to report
+    // it emptied.
+    std::unique_lock<std::shared_mutex> lock(sparse_mtx_);
+    std::erase_if(sparse_cells_, [](const auto &entry) {
+        return entry.second->Size() == 0 && entry.second->blob.ids.empty();
+    });
+
+    sparse_bounds_ = CellRange{};
+    for (const auto &entry : sparse_cells_) {
+        ExtendRange(sparse_bounds_, static_cast<int32_t>(entry.first >> 32),
+                    static_cast<int32_t>(entry.first & 0xffffffffu));
+    }
+}
+
+size_t Grid::CellCount() {
+    if (mode_ == GridMode::DENSE) return cells_.size();
+
+    std::shared_lock<std::shared_mutex> lock(sparse_mtx_);
+    return sparse_cells_.size();
+}
+
+void Grid::Search(double lower_y, double upper_y, double left_x, double right_x,
+                  std::vector<std::shared_ptr<GameObject>> &out) {
+    out.clear();
+    ForEach(lower_y, upper_y, left_x, right_x,
+            [&out](const std::shared_ptr<GameObject> &obj) { out.push_back(obj); });
+}
+
+std::vector<std::shared_ptr<GameObject>> Grid::Search(double lower_y, double upper_y,
+                                                      double left_x, double right_x) {
+    std::vector<std::shared_ptr<GameObject>> all;
+    Search(lower_y, upper_y, left_x, right_x, all);
     return all;
 }
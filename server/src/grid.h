@@ -1,49 +1,476 @@
 #ifndef GRID_H
 #define GRID_H
 
-#include <unordered_set>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
 #include <memory>
+#include <span>
+#include <string>
+#include <unordered_map>
 #include <vector>
+#include <mutex>
 #include <shared_mutex>
 
 #include "game_object.h"
+#include "function_ref.h"
+#include "constants.h"
 
+// The objects of a cell encoded once per tick (see Grid::EncodeBlobs), so
+// replication copies whole cells instead of encoding objects per client.
+struct CellBlob {
+    // Entities in records, in order, and their string IDs, copied under the
+    // cell lock so clients can be sent NAME records without touching the
+    // entity store.
+    std::vector<EntityId> ids;
+    std::vector<std::string> names;
+    // NAME records of the entities that were not in the previous blob, so
+    // subscribers learn names as entities arrive.
+    WireWriter arrivals;
+    // STATE records (binary protocol, "movement").
+    WireWriter records;
+};
+
+// Pub/sub topic of cell (row, col). The cell size is part of it, so a
+// retuned grid never shares topics with the one it replaced.
+inline std::string CellTopic(int cell_size, int row, int col) {
+    return "cell/" + std::to_string(cell_size) + '/' + std::to_string(row) + '/' + std::to_string(col);
+}
+
+// A cell stores its objects as parallel arrays (structure of arrays) so that
+// scans walk contiguous memory instead of hash buckets and scattered objects.
+// Index i in every array describes the same object. The arrays are the
+// owners' last published state (see Store), so other threads read them
+// under the cell lock rather than the entity store.
 struct Cell {
-    std::unordered_set<std::shared_ptr<GameObject>> objects;
-    std::unique_ptr<std::shared_mutex> mtx;
+    std::vector<std::shared_ptr<GameObject>> handles;
+    std::vector<double> xs, ys, vxs, vys, sizes;
+    std::vector<long long> time_updates, life_lengths;
+    std::vector<int> healths;
+    std::vector<ObjectType> types;
+    std::vector<uint8_t> charging;
+    // Largest extent stored since the cell was last empty; makes the cell's
+    // loose bounds its own rectangle grown by this much.
+    double max_size = 0;
+    // Last encoded state of the cell; may trail the arrays by a tick.
+    CellBlob blob;
+    std::shared_mutex mtx;
+
+    // Lock counters for mtx, bumped by Lock and LockShared. Contention is
+    // detected by a failed try_lock, so only waits read the clock.
+    std::atomic<uint64_t> lock_acquisitions{0};
+    std::atomic<uint64_t> contended_acquisitions{0};
+    std::atomic<uint64_t> lock_wait_ns{0};
+
+    template <typename LockType>
+    LockType Acquire() {
+        LockType lock(mtx, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            auto start = std::chrono::steady_clock::now();
+            lock.lock();
+            auto waited = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+            contended_acquisitions.fetch_add(1, std::memory_order_relaxed);
+            lock_wait_ns.fetch_add(waited, std::memory_order_relaxed);
+        }
+        lock_acquisitions.fetch_add(1, std::memory_order_relaxed);
+        return lock;
+    }
 
-    // Constructor to initialize the mutex pointer.
-    Cell() : mtx(std::make_unique<std::shared_mutex>()) {}
+    std::unique_lock<std::shared_mutex> Lock() { return Acquire<std::unique_lock<std::shared_mutex>>(); }
+    std::shared_lock<std::shared_mutex> LockShared() { return Acquire<std::shared_lock<std::shared_mutex>>(); }
 
+    // The following helpers expect the caller to hold mtx.
+    size_t Size() const { return handles.size(); }
+
+    int IndexOf(const GameObject *obj) const {
+        for (size_t i = 0; i < handles.size(); i++) {
+            if (handles[i].get() == obj) return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    void Store(size_t i, const GameObject &obj) {
+        xs[i] = obj.get_x();
+        ys[i] = obj.get_y();
+        vxs[i] = obj.get_vx();
+        vys[i] = obj.get_vy();
+        sizes[i] = obj.get_size();
+        time_updates[i] = obj.get_time_update();
+        life_lengths[i] = obj.get_life_length();
+        healths[i] = obj.get_health();
+        types[i] = obj.get_type();
+        charging[i] = obj.get_charging();
+        max_size = std::max(max_size, sizes[i]);
+    }
+
+    void Append(std::shared_ptr<GameObject> obj) {
+        handles.push_back(std::move(obj));
+        xs.emplace_back(); ys.emplace_back();
+        vxs.emplace_back(); vys.emplace_back();
+        sizes.emplace_back(); time_updates.emplace_back();
+        life_lengths.emplace_back(); healths.emplace_back();
+        types.emplace_back(); charging.emplace_back();
+        Store(handles.size() - 1, *handles.back());
+    }
+
+    // Swap-and-pop removal; order inside a cell is not meaningful.
+    void Erase(size_t i) {
+        size_t last = handles.size() - 1;
+        if (i != last) {
+            handles[i] = std::move(handles[last]);
+            xs[i] = xs[last]; ys[i] = ys[last];
+            vxs[i] = vxs[last]; vys[i] = vys[last];
+            sizes[i] = sizes[last]; time_updates[i] = time_updates[last];
+            life_lengths[i] = life_lengths[last]; healths[i] = healths[last];
+            types[i] = types[last]; charging[i] = charging[last];
+        }
+        handles.pop_back();
+        xs.pop_back(); ys.pop_back();
+        vxs.pop_back(); vys.pop_back();
+        sizes.pop_back(); time_updates.pop_back();
+        life_lengths.pop_back(); healths.pop_back();
+        types.pop_back(); charging.pop_back();
+        if (handles.empty()) max_size = 0;
+    }
+
+    // Position of entry i at current_time, extrapolated from the record.
+    void PositionAt(size_t i, long long current_time, double &x, double &y) const {
+        long long elapsed = current_time - time_updates[i];
+        x = Extrapolate(types[i], xs[i], vxs[i], elapsed);
+        y = Extrapolate(types[i], ys[i], vys[i], elapsed);
+    }
+
+    // Locking entry points.
     void Insert(std::shared_ptr<GameObject> obj) {
-        std::unique_lock<std::shared_mutex> lock(*mtx);
-        objects.insert(obj);
+        auto lock = Lock();
+        if (IndexOf(obj.get()) < 0) Append(std::move(obj));
     }
 
-    void Remove(std::shared_ptr<GameObject> obj) {
-        std::unique_lock<std::shared_mutex> lock(*mtx);
-        objects.erase(obj);
+    void Remove(const std::shared_ptr<GameObject> &obj) {
+        auto lock = Lock();
+        int i = IndexOf(obj.get());
+        if (i >= 0) Erase(i);
+    }
+
+    // Rewrites the cached record after the object changed without leaving the cell.
+    void Refresh(const std::shared_ptr<GameObject> &obj) {
+        auto lock = Lock();
+        int i = IndexOf(obj.get());
+        if (i >= 0) Store(i, *obj);
+    }
+};
+
+// Callback invoked for every object a query yields. It runs while the
+// object's cell is read-locked, so it must not call back into the grid.
+using ObjectVisitor = FunctionRef<void(const std::shared_ptr<GameObject> &)>;
+
+// Callback for a player and a snowball whose extents overlap. It runs with
+// no cell locked, so it may call back into the grid.
+using ContactVisitor = FunctionRef<void(const std::shared_ptr<GameObject> &player,
+                                        const std::shared_ptr<GameObject> &snowball)>;
+
+// Callback receiving a cell and its blob, under the cell's lock.
+using CellBlobVisitor = FunctionRef<void(int row, int col, const CellBlob &)>;
+
+// Callback receiving the cached center of a stored object.
+using PositionVisitor = FunctionRef<void(double x, double y)>;
+
+// Floors v to an int without a libm call.
+inline int FloorToInt(double v) {
+    int i = static_cast<int>(v);
+    return i - (v < i);
+}
+
+// Snapshot of one cell's occupancy and lock counters.
+struct CellCounters {
+    int row, col;
+    size_t objects;
+    uint64_t lock_acquisitions;
+    uint64_t contended_acquisitions;
+    uint64_t lock_wait_ns;
+};
+
+// DENSE preallocates every cell of a bounded world in one flat array.
+// SPARSE hashes cell coordinates and only allocates cells that hold
+// objects, so memory follows occupancy rather than world area and
+// coordinates are not bounded.
+enum class GridMode {
+    DENSE,
+    SPARSE
+};
+
+// Maps world coordinates to cells for a grid whose dimensions are only
+// known at runtime.
+struct DynamicGeometry {
+    int cell_size_, rows_, cols_;
+    bool sparse_;
+
+    bool Sparse() const { return sparse_; }
+    int cell_size() const { return cell_size_; }
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+    int RowOf(double y) const { return FloorToInt(y / cell_size_); }
+    int ColOf(double x) const { return FloorToInt(x / cell_size_); }
+    bool InBounds(int row, int col) const {
+        return sparse_ || (row >= 0 && col >= 0 && row < rows_ && col < cols_);
+    }
+};
+
+// Geometry fixed at compile time. CellSize must be a power of two, so cell
+// lookups shift instead of divide and bounds compare against constants.
+template <int Width, int Height, int CellSize>
+struct FixedGeometry {
+    static_assert(Width > 0 && Height > 0, "Grid dimensions must be positive");
+    static_assert(CellSize > 0 && (CellSize & (CellSize - 1)) == 0, "CellSize must be a power of two");
+
+    static constexpr int kShift = std::countr_zero(static_cast<unsigned>(CellSize));
+    static constexpr int kRows = (Height - 1) / CellSize + 1;
+    static constexpr int kCols = (Width - 1) / CellSize + 1;
+
+    static constexpr bool Sparse() { return false; }
+    static constexpr int cell_size() { return CellSize; }
+    static constexpr int rows() { return kRows; }
+    static constexpr int cols() { return kCols; }
+    static int RowOf(double y) { return FloorToInt(y) >> kShift; }
+    static int ColOf(double x) { return FloorToInt(x) >> kShift; }
+    static bool InBounds(int row, int col) {
+        return static_cast<unsigned>(row) < kRows && static_cast<unsigned>(col) < kCols;
     }
 };
 
 class Grid {
 
-private:
+protected:
+    GridMode mode_;
     int height_, width_;
     int cell_size_;
     int rows_, cols_;
-    std::vector<std::vector<std::unique_ptr<Cell>>> cells_;
+    // Dense cells in one row-major array: each row of a query rectangle is
+    // a contiguous run, walked in memory order by ForEachCell.
+    std::vector<Cell> cells_;
+
+    std::shared_mutex sparse_mtx_;
+    std::unordered_map<uint64_t, std::unique_ptr<Cell>> sparse_cells_;
+    // Cells spanned by the allocated sparse cells, so ring searches know
+    // when they have passed all of them. Grown on allocation, recomputed
+    // by Compact; guarded by sparse_mtx_.
+    CellRange sparse_bounds_;
+
+    // Bound on object extents, i.e. how far an object can reach outside the
+    // cell its center is bucketed in (see MaxSize): the largest cell
+    // max_size seen by the last EncodeBlobs pass, and the largest extent
+    // stored since that pass began.
+    std::atomic<double> scanned_max_size_{0};
+    std::atomic<double> recent_max_size_{0};
+
+    DynamicGeometry Geometry() const { return {cell_size_, rows_, cols_, mode_ == GridMode::SPARSE}; }
+
+    static uint64_t CellKey(int row, int col);
+    Cell &DenseCell(int row, int col) { return cells_[static_cast<size_t>(row) * cols_ + col]; }
+    Cell *FindSparseCell(int row, int col);
+    Cell &AllocateSparseCell(int row, int col);
+
+    static void Rebase(GameObject &obj, int cur_x, int cur_y, int row, int col, long long current_time);
+    static void Relocate(Cell *from, Cell &to, const std::shared_ptr<GameObject> &obj,
+                         int cur_x, int cur_y, int row, int col, long long current_time);
+
+    static void RaiseAtomic(std::atomic<double> &value, double to);
+    // Called after obj's cell stores its extent, so a pass either sees the
+    // cell or starts before the raise.
+    void RaiseMaxSize(double size);
+    void BeginMaxSizeScan();
+    double MaxSize() const;
+
+    // The algorithms are written once against a geometry policy (see
+    // grid_impl.h). Grid runs them with DynamicGeometry; FixedGrid
+    // instantiates them with compile-time constants.
+    template <typename Geo, typename Fn>
+    void WithCell(const Geo &geo, int row, int col, bool create, Fn &&fn);
+
+    template <typename Geo, typename Fn>
+    void ForEachCell(const Geo &geo, int lower_row, int upper_row, int left_col, int right_col, Fn &&fn);
+
+    template <typename Geo, typename Fn>
+    void ForEachRingCell(const Geo &geo, int row, int col, int ring, Fn &&fn);
+
+    template <typename Geo>
+    static double CellDistance(const Geo &geo, int row, int col, double x, double y);
+
+    template <typename Geo>
+    bool RingOutsideGrid(const Geo &geo, int row, int col, int ring);
+
+    template <typename Geo>
+    static int RingsFor(const Geo &geo, double reach);
+
+    template <typename Geo>
+    void InsertImpl(const Geo &geo, std::shared_ptr<GameObject> obj);
+
+    template <typename Geo>
+    void RemoveImpl(const Geo &geo, const std::shared_ptr<GameObject> &obj);
+
+    template <typename Geo>
+    void UpdateImpl(const Geo &geo, const std::shared_ptr<GameObject> &obj, long long current_time);
+
+    template <typename Geo>
+    void UpdateManyImpl(const Geo &geo, std::span<const std::shared_ptr<GameObject>> objs,
+                        long long current_time);
+
+    template <typename Geo>
+    void ForEachImpl(const Geo &geo, double lower_y, double upper_y, double left_x, double right_x,
+                     ObjectVisitor visit);
+
+    template <typename Geo>
+    void ForEachOverlappingImpl(const Geo &geo, double lower_y, double upper_y, double left_x,
+                                double right_x, long long current_time, ObjectVisitor visit);
+
+    template <typename Geo>
+    void ForEachInRadiusImpl(const Geo &geo, double x, double y, double radius, long long current_time,
+                             ObjectVisitor visit);
+
+    template <typename Geo>
+    void NearestImpl(const Geo &geo, double x, double y, size_t k, double max_radius,
+                     long long current_time, std::vector<std::shared_ptr<GameObject>> &out);
+
+    template <typename Geo>
+    void ForEachContactImpl(const Geo &geo, long long current_time, ContactVisitor visit);
+
+    template <typename Geo>
+    void ForEachCellBlobImpl(const Geo &geo, double lower_y, double upper_y, double left_x, double right_x,
+                             CellBlobVisitor visit);
 
 public:
-    Grid(int height, int width, int cell_size);
+    Grid(int height, int width, int cell_size, GridMode mode = GridMode::DENSE);
+
+    virtual ~Grid();
+
+    inline GridMode get_mode() const { return mode_; }
+    inline int get_height() const { return height_; }
+    inline int get_width() const { return width_; }
+    inline int get_cell_size() const { return cell_size_; }
+
+    virtual void Insert(std::shared_ptr<GameObject> obj);
+    virtual void Remove(std::shared_ptr<GameObject> obj);
+    // Re-buckets obj at its position at current_time. A move between cells
+    // holds both cell locks, so concurrent queries never miss the object.
+    virtual void Update(std::shared_ptr<GameObject> obj, long long current_time);
+
+    // Update for a batch of objects. Updates are grouped by the cells they
+    // touch, so each cell (or source/destination pair) is locked once.
+    virtual void UpdateMany(std::span<const std::shared_ptr<GameObject>> objs, long long current_time);
 
-    ~Grid();
+    // Visits every object in the rectangle in place, without copying handles.
+    virtual void ForEach(double lower_y, double upper_y, double left_x, double right_x, ObjectVisitor visit);
 
-    void Insert(std::shared_ptr<GameObject> obj);
-    void Remove(std::shared_ptr<GameObject> obj);
-    void Update(std::shared_ptr<GameObject> obj, long long current_time);
+    // Fills a caller-owned buffer; reusing it across calls avoids allocating.
+    void Search(double lower_y, double upper_y, double left_x, double right_x,
+                std::vector<std::shared_ptr<GameObject>> &out);
 
     std::vector<std::shared_ptr<GameObject>> Search(double lower_y, double upper_y, double left_x, double right_x);
+
+    // Like ForEach, but yields exactly the objects whose circular extent
+    // (radius get_size() around the position at current_time) overlaps the
+    // rectangle, regardless of which cell holds their center.
+    virtual void ForEachOverlapping(double lower_y, double upper_y, double left_x, double right_x,
+                                    long long current_time, ObjectVisitor visit);
+
+    void SearchOverlapping(double lower_y, double upper_y, double left_x, double right_x,
+                           long long current_time, std::vector<std::shared_ptr<GameObject>> &out);
+
+    // Visits objects whose extent comes within radius of (x, y). Cells are
+    // walked in rings outward from the center and the walk stops at the
+    // first ring that cannot hold a match.
+    virtual void ForEachInRadius(double x, double y, double radius, long long current_time,
+                                 ObjectVisitor visit);
+
+    void SearchRadius(double x, double y, double radius, long long current_time,
+                      std::vector<std::shared_ptr<GameObject>> &out);
+
+    // Fills out with the k objects whose centers are closest to (x, y),
+    // nearest first, considering only objects within max_radius. Rings stop
+    // expanding once they cannot beat the k-th candidate found so far, so
+    // sparse grids need a finite max_radius.
+    virtual void Nearest(double x, double y, size_t k, double max_radius, long long current_time,
+                         std::vector<std::shared_ptr<GameObject>> &out);
+
+    // Visits every (player, snowball) pair whose circles overlap at
+    // current_time, using the same strict test as GameObject::Collide. The
+    // whole grid is covered cell by cell: each cell holding players is
+    // tested against the snowballs of the cells within reach of it.
+    virtual void ForEachContact(long long current_time, ContactVisitor visit);
+
+    // Re-encodes every cell's blob at current_time and visits the ones that
+    // hold objects, plus those that just emptied so subscribers learn it.
+    // Meant to run once per tick, on one thread, after the simulation has
+    // moved objects.
+    void EncodeBlobs(long long current_time, CellBlobVisitor visit);
+
+    // The cells ForEach would search for the rectangle, clipped to the
+    // grid unless it is sparse.
+    CellRange CellsIn(double lower_y, double upper_y, double left_x, double right_x) const;
+
+    // Visits the non-empty blobs of the cells ForEach would search.
+    virtual void ForEachCellBlob(double lower_y, double upper_y, double left_x, double right_x,
+                                 CellBlobVisitor visit);
+
+    // Visits the cached center of every stored object, one cell at a time.
+    void ForEachPosition(PositionVisitor visit);
+
+    // Appends the counters of every allocated cell to out. Reading them
+    // does not count as a lock acquisition.
+    void CollectCounters(std::vector<CellCounters> &out);
+
+    // Zeroes the lock counters, e.g. to start a new measurement window.
+    void ResetCounters();
+
+    // Frees empty sparse cells. No-op for dense grids.
+    void Compact();
+
+    // Number of cells currently allocated.
+    size_t CellCount();
+};
+
+// Dense grid specialized for one map size. Instantiating it requires
+// grid_impl.h, which main.cpp includes for its table of supported maps.
+template <int Width, int Height, int CellSize>
+class FixedGrid final : public Grid {
+    using Geo = FixedGeometry<Width, Height, CellSize>;
+
+public:
+    FixedGrid() : Grid(Height, Width, CellSize, GridMode::DENSE) {}
+
+    void Insert(std::shared_ptr<GameObject> obj) override { InsertImpl(Geo(), std::move(obj)); }
+    void Remove(std::shared_ptr<GameObject> obj) override { RemoveImpl(Geo(), obj); }
+    void Update(std::shared_ptr<GameObject> obj, long long current_time) override {
+        UpdateImpl(Geo(), obj, current_time);
+    }
+    void UpdateMany(std::span<const std::shared_ptr<GameObject>> objs, long long current_time) override {
+        UpdateManyImpl(Geo(), objs, current_time);
+    }
+    void ForEach(double lower_y, double upper_y, double left_x, double right_x, ObjectVisitor visit) override {
+        ForEachImpl(Geo(), lower_y, upper_y, left_x, right_x, visit);
+    }
+    void ForEachOverlapping(double lower_y, double upper_y, double left_x, double right_x,
+                            long long current_time, ObjectVisitor visit) override {
+        ForEachOverlappingImpl(Geo(), lower_y, upper_y, left_x, right_x, current_time, visit);
+    }
+    void ForEachInRadius(double x, double y, double radius, long long current_time,
+                         ObjectVisitor visit) override {
+        ForEachInRadiusImpl(Geo(), x, y, radius, current_time, visit);
+    }
+    void Nearest(double x, double y, size_t k, double max_radius, long long current_time,
+                 std::vector<std::shared_ptr<GameObject>> &out) override {
+        NearestImpl(Geo(), x, y, k, max_radius, current_time, out);
+    }
+    void ForEachContact(long long current_time, ContactVisitor visit) override {
+        ForEachContactImpl(Geo(), current_time, visit);
+    }
+    void ForEachCellBlob(double lower_y, double upper_y, double left_x, double right_x,
+                         CellBlobVisitor visit) override {
+        ForEachCellBlobImpl(Geo(), lower_y, upper_y, left_x, right_x, visit);
+    }
 };
 
 #endif
@@ -0,0 +1,505 @@
+#ifndef GRID_IMPL_H
+#define GRID_IMPL_H
+
+// Geometry-generic grid algorithms. grid.cpp instantiates them for the
+// runtime-sized Grid; translation units that create FixedGrid
+// specializations include this header as well.
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+#include "grid.h"
+#include "collision.h"
+
+// Runs fn on the cell at (row, col). In sparse mode the cell map stays
+// read-locked for the duration so Compact cannot free the cell underneath;
+// with create set, a missing cell is added under the write lock.
+template <typename Geo, typename Fn>
+void Grid::WithCell(const Geo &geo, int row, int col, bool create, Fn &&fn) {
+    if (!geo.InBounds(row, col)) return;
+
+    if (!geo.Sparse()) {
+        fn(DenseCell(row, col));
+        return;
+    }
+
+    {
+        std::shared_lock<std::shared_mutex> lock(sparse_mtx_);
+        if (Cell *cell = FindSparseCell(row, col)) {
+            fn(*cell);
+            return;
+        }
+    }
+    if (!create) return;
+
+    std::unique_lock<std::shared_mutex> lock(sparse_mtx_);
+    fn(AllocateSparseCell(row, col));
+}
+
+template <typename Geo>
+void Grid::InsertImpl(const Geo &geo, std::shared_ptr<GameObject> obj) {
+    int row = geo.RowOf(obj->get_y());
+    int col = geo.ColOf(obj->get_x());
+
+    if (!geo.InBounds(row, col)) return;
+
+    obj->set_row(row);
+    obj->set_col(col);
+
+    WithCell(geo, row, col, true, [&obj](Cell &cell) { cell.Insert(obj); });
+    RaiseMaxSize(obj->get_size());
+}
+
+
+template <typename Geo>
+void Grid::RemoveImpl(const Geo &geo, const std::shared_ptr<GameObject> &obj) {
+    WithCell(geo, obj->get_row(), obj->get_col(), false, [&obj](Cell &cell) { cell.Remove(obj); });
+}
+
+template <typename Geo>
+void Grid::UpdateImpl(const Geo &geo, const std::shared_ptr<GameObject> &obj, long long current_time) {
+    int old_row = obj->get_row();
+    int old_col = obj->get_col();
+    int cur_y = static_cast<int>(obj->get_cur_y(current_time));
+    int cur_x = static_cast<int>(obj->get_cur_x(current_time));
+    int new_row = geo.RowOf(cur_y);
+    int new_col = geo.ColOf(cur_x);
+
+    if (!geo.InBounds(new_row, new_col)) return;
+
+    if ((old_row == new_row) && (old_col == new_col)) {
+        WithCell(geo, new_row, new_col, false, [&obj](Cell &cell) { cell.Refresh(obj); });
+        RaiseMaxSize(obj->get_size());
+        return;
+    }
+
+    auto move = [&](Cell *from, Cell &to) {
+        // Lock in address order so concurrent moves cannot deadlock.
+        Cell *first = &to, *second = from;
+        if (second && std::less<Cell *>()(second, first)) std::swap(first, second);
+        auto first_lock = first->Lock();
+        std::unique_lock<std::shared_mutex> second_lock;
+        if (second && second != first) second_lock = second->Lock();
+
+        Relocate(from, to, obj, cur_x, cur_y, new_row, new_col, current_time);
+    };
+
+    if (!geo.Sparse()) {
+        Cell *from = geo.InBounds(old_row, old_col) ? &DenseCell(old_row, old_col) : nullptr;
+        move(from, DenseCell(new_row, new_col));
+    } else {
+        std::shared_lock<std::shared_mutex> read_lock(sparse_mtx_);
+        Cell *from = FindSparseCell(old_row, old_col);
+        if (Cell *to = FindSparseCell(new_row, new_col)) {
+            move(from, *to);
+        } else {
+            // The destination does not exist yet; create it under the write lock.
+            read_lock.unlock();
+            std::unique_lock<std::shared_mutex> lock(sparse_mtx_);
+            Cell &created = AllocateSparseCell(new_row, new_col);
+            move(FindSparseCell(old_row, old_col), created);
+        }
+    }
+    RaiseMaxSize(obj->get_size());
+}
+
+template <typename Geo>
+void Grid::UpdateManyImpl(const Geo &geo, std::span<const std::shared_ptr<GameObject>> objs,
+                          long long current_time) {
+    struct PendingUpdate {
+        const std::shared_ptr<GameObject> *obj;
+        int cur_x, cur_y, row, col;
+        Cell *from, *to;
+    };
+    thread_local std::vector<PendingUpdate> pending;
+
+    // Evaluates the whole batch's positions in one pass.
+    thread_local std::vector<EntityId> ids;
+    thread_local std::vector<double> xs, ys;
+    ids.clear();
+    for (const auto &obj : objs) ids.push_back(obj->get_id());
+    xs.resize(ids.size());
+    ys.resize(ids.size());
+    EvaluatePositions(ids, current_time, xs, ys);
+
+    pending.clear();
+    for (size_t i = 0; i < objs.size(); i++) {
+        const auto &obj = objs[i];
+        int cur_y = static_cast<int>(ys[i]);
+        int cur_x = static_cast<int>(xs[i]);
+        int row = geo.RowOf(cur_y), col = geo.ColOf(cur_x);
+        if (!geo.InBounds(row, col)) continue;
+        pending.push_back({&obj, cur_x, cur_y, row, col, nullptr, nullptr});
+    }
+    if (pending.empty()) return;
+
+    // Sorts the batch by the pair of cells it touches, then takes each
+    // pair's locks once (in address order) for all of its refreshes and moves.
+    auto apply = [&]() {
+        auto cell_pair = [](const PendingUpdate &p) {
+            Cell *first = p.to, *second = p.from ? p.from : p.to;
+            if (std::less<Cell *>()(second, first)) std::swap(first, second);
+            return std::make_pair(first, second);
+        };
+        std::sort(pending.begin(), pending.end(), [&](const PendingUpdate &a, const PendingUpdate &b) {
+            return std::less<std::pair<Cell *, Cell *>>()(cell_pair(a), cell_pair(b));
+        });
+
+        for (size_t begin = 0, end = 0; begin < pending.size(); begin = end) {
+            auto [first, second] = cell_pair(pending[begin]);
+            while (end < pending.size() && cell_pair(pending[end]) == std::make_pair(first, second)) end++;
+
+            auto first_lock = first->Lock();
+            std::unique_lock<std::shared_mutex> second_lock;
+            if (second != first) second_lock = second->Lock();
+
+            for (size_t i = begin; i < end; i++) {
+                const auto &p = pending[i];
+                const auto &obj = *p.obj;
+                if (p.from == p.to) {
+                    int index = p.to->IndexOf(obj.get());
+                    if (index >= 0) p.to->Store(index, *obj);
+                } else {
+                    Relocate(p.from, *p.to, obj, p.cur_x, p.cur_y, p.row, p.col, current_time);
+                }
+            }
+        }
+
+        double max_size = 0;
+        for (const auto &p : pending) max_size = std::max(max_size, (*p.obj)->get_size());
+        RaiseMaxSize(max_size);
+    };
+
+    if (!geo.Sparse()) {
+        for (auto &p : pending) {
+            const auto &obj = *p.obj;
+            bool known = geo.InBounds(obj->get_row(), obj->get_col());
+            p.from = known ? &DenseCell(obj->get_row(), obj->get_col()) : nullptr;
+            p.to = &DenseCell(p.row, p.col);
+        }
+        apply();
+        return;
+    }
+
+    // Resolve every cell under the map read lock; if a destination is
+    // missing, create it and retry, since Compact may run in between.
+    for (;;) {
+        {
+            std::shared_lock<std::shared_mutex> lock(sparse_mtx_);
+            bool resolved = true;
+            for (auto &p : pending) {
+                const auto &obj = *p.obj;
+                p.from = FindSparseCell(obj->get_row(), obj->get_col());
+                p.to = FindSparseCell(p.row, p.col);
+                resolved = resolved && p.to;
+            }
+            if (resolved) {
+                apply();
+                return;
+            }
+        }
+        for (const auto &p : pending) {
+            if (!p.to) WithCell(geo, p.row, p.col, true, [](Cell &) {});
+        }
+    }
+}
+
+// Runs fn(row, col, cell) on every allocated cell in the given index range.
+template <typename Geo, typename Fn>
+void Grid::ForEachCell(const Geo &geo, int lower_row, int upper_row, int left_col, int right_col,
+                       Fn &&fn) {
+    if (!geo.Sparse()) {
+        for (int r = std::max(lower_row, 0); r <= std::min(upper_row, geo.rows() - 1); r++) {
+            for (int c = std::max(left_col, 0); c <= std::min(right_col, geo.cols() - 1); c++) {
+                fn(r, c, DenseCell(r, c));
+            }
+        }
+        return;
+    }
+
+    std::shared_lock<std::shared_mutex> lock(sparse_mtx_);
+    long long span = static_cast<long long>(upper_row - lower_row + 1) * (right_col - left_col + 1);
+
+    // Probe each cell of the rectangle, unless fewer cells exist in total
+    // than the rectangle covers; then walking the map is cheaper.
+    if (span <= static_cast<long long>(sparse_cells_.size())) {
+        for (int r = lower_row; r <= upper_row; r++) {
+            for (int c = left_col; c <= right_col; c++) {
+                if (Cell *cell = FindSparseCell(r, c)) fn(r, c, *cell);
+            }
+        }
+    } else {
+        for (auto &[key, cell] : sparse_cells_) {
+            int r = static_cast<int32_t>(key >> 32);
+            int c = static_cast<int32_t>(key & 0xffffffffu);
+            if (r < lower_row || r > upper_row || c < left_col || c > right_col) continue;
+            fn(r, c, *cell);
+        }
+    }
+}
+
+template <typename Geo>
+void Grid::ForEachImpl(const Geo &geo, double lower_y, double upper_y, double left_x, double right_x,
+                       ObjectVisitor visit) {
+    ForEachCell(geo, geo.RowOf(lower_y), geo.RowOf(upper_y), geo.ColOf(left_x), geo.ColOf(right_x),
+                [&visit](int, int, Cell &cell) {
+        auto lock = cell.LockShared();
+        for (const auto &handle : cell.handles) {
+            visit(handle);
+        }
+    });
+}
+
+template <typename Geo>
+void Grid::ForEachCellBlobImpl(const Geo &geo, double lower_y, double upper_y, double left_x, double right_x,
+                               CellBlobVisitor visit) {
+    ForEachCell(geo, geo.RowOf(lower_y), geo.RowOf(upper_y), geo.ColOf(left_x), geo.ColOf(right_x),
+                [&visit](int row, int col, Cell &cell) {
+        auto lock = cell.LockShared();
+        if (!cell.blob.ids.empty()) visit(row, col, cell.blob);
+    });
+}
+
+template <typename Geo>
+void Grid::ForEachOverlappingImpl(const Geo &geo, double lower_y, double upper_y, double left_x,
+                                  double right_x, long long current_time, ObjectVisitor visit) {
+    // Objects are bucketed by center, so any object reaching into the
+    // rectangle sits at most one extent (plus drift) outside of it.
+    double margin = MaxSize() + constants::MAX_OBJECT_DRIFT;
+    int lower_row = geo.RowOf(lower_y - margin), upper_row = geo.RowOf(upper_y + margin);
+    int left_col = geo.ColOf(left_x - margin), right_col = geo.ColOf(right_x + margin);
+
+    ForEachCell(geo, lower_row, upper_row, left_col, right_col,
+                [&](int r, int c, Cell &cell) {
+        auto lock = cell.LockShared();
+
+        // Skip the cell unless its loose bounds reach the rectangle.
+        double cell_margin = cell.max_size + constants::MAX_OBJECT_DRIFT;
+        if ((c + 1) * geo.cell_size() + cell_margin < left_x || c * geo.cell_size() - cell_margin > right_x ||
+            (r + 1) * geo.cell_size() + cell_margin < lower_y || r * geo.cell_size() - cell_margin > upper_y) {
+            return;
+        }
+
+        for (size_t i = 0; i < cell.Size(); i++) {
+            double x, y;
+            cell.PositionAt(i, current_time, x, y);
+            double dx = x - std::clamp(x, left_x, right_x);
+            double dy = y - std::clamp(y, lower_y, upper_y);
+            if (dx * dx + dy * dy <= cell.sizes[i] * cell.sizes[i]) {
+                visit(cell.handles[i]);
+            }
+        }
+    });
+}
+
+// Runs fn(row, col, cell) on the allocated cells at Chebyshev distance
+// ring from (row, col).
+template <typename Geo, typename Fn>
+void Grid::ForEachRingCell(const Geo &geo, int row, int col, int ring, Fn &&fn) {
+    auto visit = [&](int r, int c) {
+        WithCell(geo, r, c, false, [&](Cell &cell) { fn(r, c, cell); });
+    };
+
+    if (ring == 0) {
+        visit(row, col);
+        return;
+    }
+    for (int c = col - ring; c <= col + ring; c++) {
+        visit(row - ring, c);
+        visit(row + ring, c);
+    }
+    for (int r = row - ring + 1; r <= row + ring - 1; r++) {
+        visit(r, col - ring);
+        visit(r, col + ring);
+    }
+}
+
+// Distance from (x, y) to the nearest point of cell (row, col).
+template <typename Geo>
+double Grid::CellDistance(const Geo &geo, int row, int col, double x, double y) {
+    double dx = std::max({col * geo.cell_size() - x, 0.0, x - (col + 1) * geo.cell_size()});
+    double dy = std::max({row * geo.cell_size() - y, 0.0, y - (row + 1) * geo.cell_size()});
+    return std::sqrt(dx * dx + dy * dy);
+}
+
+// True once rings 0..ring around (row, col) have covered every cell that
+// can hold objects: the whole grid if dense, the allocated cells if sparse.
+template <typename Geo>
+bool Grid::RingOutsideGrid(const Geo &geo, int row, int col, int ring) {
+    if (!geo.Sparse()) return ring >= std::max({row, geo.rows() - 1 - row, col, geo.cols() - 1 - col});
+
+    std::shared_lock<std::shared_mutex> lock(sparse_mtx_);
+    if (sparse_cells_.empty()) return true;
+    const CellRange &b = sparse_bounds_;
+    return ring >= std::max({static_cast<long long>(row) - b.lower_row, static_cast<long long>(b.upper_row) - row,
+                             static_cast<long long>(col) - b.left_col, static_cast<long long>(b.right_col) - col});
+}
+
+// Rings around a cell needed to cover reach, capped where more rings add
+// no cells (dense) or where ring arithmetic would overflow (sparse).
+template <typename Geo>
+int Grid::RingsFor(const Geo &geo, double reach) {
+    double limit = geo.Sparse() ? std::numeric_limits<int>::max() / 4 : std::max(geo.rows(), geo.cols());
+    double rings = std::ceil(reach / geo.cell_size());
+    return rings < limit ? static_cast<int>(rings) : static_cast<int>(limit);
+}
+
+template <typename Geo>
+void Grid::ForEachInRadiusImpl(const Geo &geo, double x, double y, double radius, long long current_time,
+                               ObjectVisitor visit) {
+    int row = geo.RowOf(y), col = geo.ColOf(x);
+    double reach = radius + MaxSize() + constants::MAX_OBJECT_DRIFT;
+    int last_ring = RingsFor(geo, reach);
+
+    for (int ring = 0; ring <= last_ring; ring++) {
+        ForEachRingCell(geo, row, col, ring, [&](int r, int c, Cell &cell) {
+            auto lock = cell.LockShared();
+            double cell_reach = radius + cell.max_size + constants::MAX_OBJECT_DRIFT;
+            if (CellDistance(geo, r, c, x, y) > cell_reach) return;
+
+            for (size_t i = 0; i < cell.Size(); i++) {
+                double obj_x, obj_y;
+                cell.PositionAt(i, current_time, obj_x, obj_y);
+                double dx = obj_x - x, dy = obj_y - y;
+                double limit = radius + cell.sizes[i];
+                if (dx * dx + dy * dy <= limit * limit) {
+                    visit(cell.handles[i]);
+                }
+            }
+        });
+        if (RingOutsideGrid(geo, row, col, ring)) break;
+    }
+}
+
+template <typename Geo>
+void Grid::NearestImpl(const Geo &geo, double x, double y, size_t k, double max_radius,
+                       long long current_time, std::vector<std::shared_ptr<GameObject>> &out) {
+    out.clear();
+    if (k == 0) return;
+
+    // Max-heap on squared distance holding the best k candidates so far.
+    using Candidate = std::pair<double, std::shared_ptr<GameObject>>;
+    thread_local std::vector<Candidate> best;
+    best.clear();
+    auto farther = [](const Candidate &a, const Candidate &b) { return a.first < b.first; };
+
+    int row = geo.RowOf(y), col = geo.ColOf(x);
+    double max_dist2 = max_radius * max_radius;
+
+    for (int ring = 0;; ring++) {
+        // Any center in this ring is at least ring - 1 full cells away,
+        // less whatever it drifted since it was bucketed.
+        double ring_min = std::max((ring - 1) * geo.cell_size() - constants::MAX_OBJECT_DRIFT, 0.0);
+        if (ring_min > max_radius) break;
+        if (best.size() == k && ring_min * ring_min > best.front().first) break;
+
+        ForEachRingCell(geo, row, col, ring, [&](int r, int c, Cell &cell) {
+            double cell_min = std::max(CellDistance(geo, r, c, x, y) - constants::MAX_OBJECT_DRIFT, 0.0);
+            if (best.size() == k && cell_min * cell_min > best.front().first) return;
+
+            auto lock = cell.LockShared();
+            for (size_t i = 0; i < cell.Size(); i++) {
+                double obj_x, obj_y;
+                cell.PositionAt(i, current_time, obj_x, obj_y);
+                double dist2 = (obj_x - x) * (obj_x - x) + (obj_y - y) * (obj_y - y);
+                if (dist2 > max_dist2) continue;
+                if (best.size() < k) {
+                    best.emplace_back(dist2, cell.handles[i]);
+                    std::push_heap(best.begin(), best.end(), farther);
+                } else if (dist2 < best.front().first) {
+                    std::pop_heap(best.begin(), best.end(), farther);
+                    best.back() = Candidate(dist2, cell.handles[i]);
+                    std::push_heap(best.begin(), best.end(), farther);
+                }
+            }
+        });
+        if (RingOutsideGrid(geo, row, col, ring)) break;
+    }
+
+    std::sort_heap(best.begin(), best.end(), farther);
+    for (auto &candidate : best) {
+        out.push_back(std::move(candidate.second));
+    }
+    best.clear();
+}
+
+template <typename Geo>
+void Grid::ForEachContactImpl(const Geo &geo, long long current_time, ContactVisitor visit) {
+    struct Target {
+        int row, col;
+        double x, y, size;
+        std::shared_ptr<GameObject> handle;
+    };
+    thread_local std::vector<Target> targets;
+    thread_local std::vector<std::shared_ptr<GameObject>> snowballs;
+    thread_local std::vector<double> xs, ys, sizes;
+    thread_local std::vector<uint64_t> hits;
+
+    // Copy out every player first, one cell lock at a time. A cell's
+    // players end up next to each other.
+    targets.clear();
+    auto gather_players = [&](int r, int c, Cell &cell) {
+        auto lock = cell.LockShared();
+        for (size_t i = 0; i < cell.Size(); i++) {
+            if (cell.types[i] != ObjectType::PLAYER) continue;
+            double x, y;
+            cell.PositionAt(i, current_time, x, y);
+            targets.push_back({r, c, x, y, cell.sizes[i], cell.handles[i]});
+        }
+    };
+    if (!geo.Sparse()) {
+        ForEachCell(geo, 0, geo.rows() - 1, 0, geo.cols() - 1, gather_players);
+    } else {
+        std::shared_lock<std::shared_mutex> lock(sparse_mtx_);
+        for (auto &[key, cell] : sparse_cells_) {
+            gather_players(static_cast<int32_t>(key >> 32), static_cast<int32_t>(key & 0xffffffffu), *cell);
+        }
+    }
+
+    // Both centers may sit an extent plus drift outside their cells.
+    double reach = 2 * (MaxSize() + constants::MAX_OBJECT_DRIFT);
+    int ring = RingsFor(geo, reach);
+
+    for (size_t begin = 0, end = 0; begin < targets.size(); begin = end) {
+        int row = targets[begin].row, col = targets[begin].col;
+        while (end < targets.size() && targets[end].row == row && targets[end].col == col) end++;
+
+        snowballs.clear();
+        xs.clear();
+        ys.clear();
+        sizes.clear();
+        ForEachCell(geo, row - ring, row + ring, col - ring, col + ring, [&](int, int, Cell &cell) {
+            auto lock = cell.LockShared();
+            for (size_t i = 0; i < cell.Size(); i++) {
+                if (cell.types[i] != ObjectType::SNOWBALL) continue;
+                double x, y;
+                cell.PositionAt(i, current_time, x, y);
+                snowballs.push_back(cell.handles[i]);
+                xs.push_back(x);
+                ys.push_back(y);
+                sizes.push_back(cell.sizes[i]);
+            }
+        });
+        if (snowballs.empty()) continue;
+
+        hits.resize(HitMaskWords(snowballs.size()));
+        for (size_t t = begin; t < end; t++) {
+            const Target &target = targets[t];
+            CircleHitMask(target.x, target.y, target.size, xs.data(), ys.data(), sizes.data(), snowballs.size(),
+                          hits.data());
+            for (size_t w = 0; w < hits.size(); w++) {
+                for (uint64_t bits = hits[w]; bits; bits &= bits - 1) {
+                    visit(target.handle, snowballs[w * 64 + std::countr_zero(bits)]);
+                }
+            }
+        }
+    }
+
+    // Drop the handles so the pass does not keep objects alive.
+    targets.clear();
+    snowballs.clear();
+}
+
+#endif
@@ -0,0 +1,195 @@
+#include "grid_stats.h"
+
+#include <climits>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Largest bounding box (in cells) QueryCost builds a summed-area table for.
+static constexpr long long MAX_COST_TABLE_CELLS = 1 << 22;
+// Largest bounding box (in cells) CounterHeatmap lays out as matrices.
+static constexpr long long MAX_HEATMAP_CELLS = 1 << 22;
+
+GridStats::GridStats(int width, int height)
+    : width_(width), height_(height), bin_size_(constants::MIN_GRID_CELL_SIZE), samples_(0) {}
+
+uint64_t GridStats::BinKey(int row, int col) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(row)) << 32) | static_cast<uint32_t>(col);
+}
+
+void GridStats::Sample(Grid &grid) {
+    grid.ForEachPosition([this](double x, double y) {
+        bins_[BinKey(FloorToInt(y / bin_size_), FloorToInt(x / bin_size_))]++;
+    });
+    samples_++;
+}
+
+void GridStats::Reset() {
+    bins_.clear();
+    samples_ = 0;
+}
+
+void GridStats::Merge(const GridStats &other) {
+    for (const auto &[key, count] : other.bins_) bins_[key] += count;
+    samples_ += other.samples_;
+}
+
+double GridStats::QueryCost(int cell_size) const {
+    if (samples_ == 0 || bins_.empty()) return 0;
+
+    int ratio = cell_size / bin_size_;
+    auto floor_div = [](int a, int b) { return a / b - (a % b < 0); };
+    auto bin_row = [](uint64_t key) { return static_cast<int>(static_cast<int32_t>(key >> 32)); };
+    auto bin_col = [](uint64_t key) { return static_cast<int>(static_cast<int32_t>(key & 0xffffffffu)); };
+
+    // Bounding box of the occupied cells at this cell size.
+    int min_row = INT_MAX, max_row = INT_MIN, min_col = INT_MAX, max_col = INT_MIN;
+    for (const auto &entry : bins_) {
+        int r = floor_div(bin_row(entry.first), ratio);
+        int c = floor_div(bin_col(entry.first), ratio);
+        min_row = std::min(min_row, r); max_row = std::max(max_row, r);
+        min_col = std::min(min_col, c); max_col = std::max(max_col, c);
+    }
+    long long rows = static_cast<long long>(max_row) - min_row + 1;
+    long long cols = static_cast<long long>(max_col) - min_col + 1;
+    if ((rows + 1) * (cols + 1) > MAX_COST_TABLE_CELLS) return std::numeric_limits<double>::infinity();
+
+    // Summed-area table of object counts, so each query's object total is
+    // four lookups.
+    std::vector<long long> table((rows + 1) * (cols + 1), 0);
+    auto at = [&](long long r, long long c) -> long long & { return table[r * (cols + 1) + c]; };
+    for (const auto &[key, count] : bins_) {
+        at(floor_div(bin_row(key), ratio) - min_row + 1, floor_div(bin_col(key), ratio) - min_col + 1) += count;
+    }
+    for (long long r = 1; r <= rows; r++) {
+        for (long long c = 1; c <= cols; c++) {
+            at(r, c) += at(r - 1, c) + at(r, c - 1) - at(r - 1, c - 1);
+        }
+    }
+    auto objects_in = [&](int r0, int r1, int c0, int c1) -> long long {
+        long long lo_r = std::max<long long>(r0, min_row) - min_row;
+        long long hi_r = std::min<long long>(r1, max_row) - min_row + 1;
+        long long lo_c = std::max<long long>(c0, min_col) - min_col;
+        long long hi_c = std::min<long long>(c1, max_col) - min_col + 1;
+        if (lo_r >= hi_r || lo_c >= hi_c) return 0;
+        return at(hi_r, hi_c) - at(lo_r, hi_c) - at(hi_r, lo_c) + at(lo_r, lo_c);
+    };
+
+    // Dense grids clamp queries to the world; sparse ones probe every cell.
+    int last_row = height_ > 0 ? (height_ - 1) / cell_size : INT_MAX;
+    int last_col = width_ > 0 ? (width_ - 1) / cell_size : INT_MAX;
+    int first_row = height_ > 0 ? 0 : INT_MIN;
+    int first_col = width_ > 0 ? 0 : INT_MIN;
+
+    // Every recorded object stands in for a query centered on it.
+    double total = 0, weight = 0;
+    for (const auto &[key, count] : bins_) {
+        double x = (bin_col(key) + 0.5) * bin_size_;
+        double y = (bin_row(key) + 0.5) * bin_size_;
+        int r0 = std::max(FloorToInt((y - constants::FIXED_VIEW_HEIGHT) / cell_size), first_row);
+        int r1 = std::min(FloorToInt((y + constants::FIXED_VIEW_HEIGHT) / cell_size), last_row);
+        int c0 = std::max(FloorToInt((x - constants::FIXED_VIEW_WIDTH) / cell_size), first_col);
+        int c1 = std::min(FloorToInt((x + constants::FIXED_VIEW_WIDTH) / cell_size), last_col);
+        if (r0 > r1 || c0 > c1) continue;
+
+        double cells = static_cast<double>(r1 - r0 + 1) * (c1 - c0 + 1);
+        double objects = static_cast<double>(objects_in(r0, r1, c0, c1)) / samples_;
+        total += count * (constants::GRID_CELL_VISIT_COST * cells + constants::GRID_OBJECT_VISIT_COST * objects);
+        weight += count;
+    }
+    return weight > 0 ? total / weight : 0;
+}
+
+int GridStats::Recommend() const {
+    if (samples_ == 0 || bins_.empty()) return 0;
+
+    int best = 0;
+    double best_cost = std::numeric_limits<double>::infinity();
+    for (int size = constants::MIN_GRID_CELL_SIZE; size <= constants::MAX_GRID_CELL_SIZE; size *= 2) {
+        double cost = QueryCost(size);
+        if (cost < best_cost) {
+            best = size;
+            best_cost = cost;
+        }
+    }
+    return best;
+}
+
+void GridStats::Save(std::ostream &out) const {
+    out << "grid_stats " << bin_size_ << ' ' << samples_ << '\n';
+    for (const auto &[key, count] : bins_) {
+        out << static_cast<int32_t>(key >> 32) << ' ' << static_cast<int32_t>(key & 0xffffffffu)
+            << ' ' << count << '\n';
+    }
+}
+
+bool GridStats::Load(std::istream &in) {
+    std::string tag;
+    int bin_size = 0;
+    long long samples = 0;
+    if (!(in >> tag >> bin_size >> samples) || tag != "grid_stats" || bin_size != bin_size_ || samples < 0) {
+        return false;
+    }
+
+    std::unordered_map<uint64_t, long long> bins;
+    int row, col;
+    long long count;
+    while (in >> row >> col >> count) bins[BinKey(row, col)] += count;
+    if (!in.eof()) return false;
+
+    for (const auto &[key, c] : bins) bins_[key] += c;
+    samples_ += samples;
+    return true;
+}
+
+nlohmann::json CounterHeatmap(Grid &grid) {
+    std::vector<CellCounters> counters;
+    grid.CollectCounters(counters);
+
+    int min_row = 0, max_row = -1, min_col = 0, max_col = -1;
+    if (!counters.empty()) {
+        min_row = max_row = counters[0].row;
+        min_col = max_col = counters[0].col;
+    }
+    for (const auto &cell : counters) {
+        min_row = std::min(min_row, cell.row); max_row = std::max(max_row, cell.row);
+        min_col = std::min(min_col, cell.col); max_col = std::max(max_col, cell.col);
+    }
+    int rows = max_row - min_row + 1, cols = max_col - min_col + 1;
+
+    // Sparse cells can be arbitrarily far apart; list them instead.
+    if (static_cast<long long>(rows) * cols > MAX_HEATMAP_CELLS) {
+        nlohmann::json cells = nlohmann::json::array();
+        for (const auto &cell : counters) {
+            cells.push_back({
+                {"row", cell.row},
+                {"col", cell.col},
+                {"objects", cell.objects},
+                {"lockAcquisitions", cell.lock_acquisitions},
+                {"contendedAcquisitions", cell.contended_acquisitions},
+                {"lockWaitUs", cell.lock_wait_ns / 1000.0},
+            });
+        }
+        return {{"cellSize", grid.get_cell_size()}, {"cells", cells}};
+    }
+
+    auto matrix = [&](auto value) {
+        std::vector<std::vector<double>> m(rows, std::vector<double>(cols, 0));
+        for (const auto &cell : counters) m[cell.row - min_row][cell.col - min_col] = value(cell);
+        return m;
+    };
+
+    return {
+        {"cellSize", grid.get_cell_size()},
+        {"originRow", min_row},
+        {"originCol", min_col},
+        {"rows", rows},
+        {"cols", cols},
+        {"objects", matrix([](const CellCounters &c) { return static_cast<double>(c.objects); })},
+        {"lockAcquisitions", matrix([](const CellCounters &c) { return static_cast<double>(c.lock_acquisitions); })},
+        {"contendedAcquisitions", matrix([](const CellCounters &c) { return static_cast<double>(c.contended_acquisitions); })},
+        {"lockWaitUs", matrix([](const CellCounters &c) { return c.lock_wait_ns / 1000.0; })},
+    };
+}
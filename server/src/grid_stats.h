@@ -0,0 +1,68 @@
+#ifndef GRID_STATS_H
+#define GRID_STATS_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <unordered_map>
+
+#include "nlohmann/json.hpp"
+
+#include "grid.h"
+
+// Accumulates how objects are spread over the map and estimates which cell
+// size keeps view queries cheapest.
+//
+// Occupancy is recorded per bin of MIN_GRID_CELL_SIZE units, summed over
+// samples. Every candidate cell size is a multiple of the bin size, so the
+// histogram for a candidate grid is obtained by merging bins.
+class GridStats {
+    int width_, height_;
+    int bin_size_;
+    long long samples_;
+    // Bin key (row, col) -> objects seen in that bin across all samples.
+    std::unordered_map<uint64_t, long long> bins_;
+
+    static uint64_t BinKey(int row, int col);
+
+public:
+    // width and height bound the dense worlds' cell ranges; pass 0 for an
+    // unbounded (sparse) world.
+    GridStats(int width, int height);
+
+    // Adds one snapshot of the grid's current occupancy.
+    void Sample(Grid &grid);
+
+    void Reset();
+
+    // Adds the samples of other, e.g. to fold a window into a session.
+    void Merge(const GridStats &other);
+
+    inline long long get_samples() const { return samples_; }
+
+    // Estimated cost of one view query (Grid::Search over a rectangle of
+    // 2*FIXED_VIEW_WIDTH by 2*FIXED_VIEW_HEIGHT) centered on an average
+    // object, in units of GRID_OBJECT_VISIT_COST. Returns 0 without samples.
+    double QueryCost(int cell_size) const;
+
+    // Power-of-two cell size in [MIN_GRID_CELL_SIZE, MAX_GRID_CELL_SIZE]
+    // with the lowest QueryCost, or 0 without samples.
+    int Recommend() const;
+
+    // Text format: a header line, then one "row col count" line per bin.
+    void Save(std::ostream &out) const;
+    // Merges a recorded session; returns false if it is malformed or was
+    // recorded with a different bin size.
+    bool Load(std::istream &in);
+};
+
+// Lays the grid's per-cell counters (see Grid::CollectCounters) out as
+// row-major matrices over the bounding box of allocated cells, one per
+// counter, for plotting as heatmaps:
+//   {"cellSize", "originRow", "originCol", "rows", "cols",
+//    "objects", "lockAcquisitions", "contendedAcquisitions", "lockWaitUs"}
+// If the box is too large for that (sparse cells far apart), the allocated
+// cells are listed instead:
+//   {"cellSize", "cells": [{"row", "col", "objects", ...}, ...]}
+nlohmann::json CounterHeatmap(Grid &grid);
+
+#endif
@@ -0,0 +1,87 @@
+#include "kinematics.h"
+
+#include <cmath>
+
+// The vector sweep reads the full-width component layout.
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(ENTITY_COMPACT_STATE)
+#include <immintrin.h>
+#define KINEMATICS_X86 1
+#endif
+
+static inline uint8_t SlotFlags(const EntityChunk &chunk, uint32_t i, bool crossed, bool expired) {
+    if (!chunk.simulated[i]) return 0;
+    bool dead = chunk.dead[i].load(std::memory_order_relaxed);
+    return (crossed ? SWEEP_CROSSED : 0) | (expired ? SWEEP_EXPIRED : 0) | (dead ? SWEEP_DEAD : 0);
+}
+
+void SweepChunkScalar(const EntityChunk &chunk, long long current_time, int cell_size, uint8_t *flags) {
+    for (uint32_t i = 0; i < ENTITY_CHUNK_SIZE; i++) {
+        long long elapsed = current_time - chunk.time_updates[i];
+        int cur_x = static_cast<int>(chunk.xs[i] + chunk.vxs[i] * (elapsed / 1000.0));
+        int cur_y = static_cast<int>(chunk.ys[i] + chunk.vys[i] * (elapsed / 1000.0));
+        int col = static_cast<int>(std::floor(cur_x / static_cast<double>(cell_size)));
+        int row = static_cast<int>(std::floor(cur_y / static_cast<double>(cell_size)));
+        flags[i] = SlotFlags(chunk, i, row != chunk.rows[i] || col != chunk.cols[i],
+                             LifeOver(elapsed, chunk.life_lengths[i]));
+    }
+}
+
+#ifdef KINEMATICS_X86
+// Cells of four coordinates moving at vel for secs, as Grid::Update computes them.
+__attribute__((target("avx2")))
+static inline __m128i CellOf4(__m256d pos, __m256d vel, __m256d secs, __m256d size) {
+    __m128i cur = _mm256_cvttpd_epi32(_mm256_add_pd(pos, _mm256_mul_pd(vel, secs)));
+    return _mm256_cvttpd_epi32(_mm256_floor_pd(_mm256_div_pd(_mm256_cvtepi32_pd(cur), size)));
+}
+
+// Four slots per iteration: 4 doubles per coordinate, 4 int32 cells.
+__attribute__((target("avx2")))
+static void SweepChunkAvx2(const EntityChunk &chunk, long long current_time, int cell_size, uint8_t *flags) {
+    // int64 -> double for |v| < 2^51: add the bits of 1.5 * 2^52 and
+    // subtract it back as a double (AVX2 has no direct conversion).
+    const __m256i magic_bits = _mm256_set1_epi64x(0x4338000000000000LL);
+    const __m256d magic = _mm256_set1_pd(6755399441055744.0);
+    const __m256i now = _mm256_set1_epi64x(current_time);
+    const __m256d thousand = _mm256_set1_pd(1000.0);
+    const __m256d size = _mm256_set1_pd(cell_size);
+
+    for (uint32_t i = 0; i < ENTITY_CHUNK_SIZE; i += 4) {
+        __m256i t0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&chunk.time_updates[i]));
+        __m256i elapsed = _mm256_sub_epi64(now, t0);
+        __m256d secs = _mm256_div_pd(
+            _mm256_sub_pd(_mm256_castsi256_pd(_mm256_add_epi64(elapsed, magic_bits)), magic), thousand);
+
+        __m128i col = CellOf4(_mm256_loadu_pd(&chunk.xs[i]), _mm256_loadu_pd(&chunk.vxs[i]), secs, size);
+        __m128i row = CellOf4(_mm256_loadu_pd(&chunk.ys[i]), _mm256_loadu_pd(&chunk.vys[i]), secs, size);
+        __m128i same = _mm_and_si128(
+            _mm_cmpeq_epi32(row, _mm_loadu_si128(reinterpret_cast<const __m128i *>(&chunk.rows[i]))),
+            _mm_cmpeq_epi32(col, _mm_loadu_si128(reinterpret_cast<const __m128i *>(&chunk.cols[i]))));
+        int crossed = ~_mm_movemask_ps(_mm_castsi128_ps(same)) & 0xf;
+
+        // As LifeOver: negative elapsed times count as zero.
+        __m256i life = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&chunk.life_lengths[i]));
+        __m256i aged = _mm256_and_si256(elapsed, _mm256_cmpgt_epi64(elapsed, _mm256_setzero_si256()));
+        int expired = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(aged, life)));
+
+        for (uint32_t k = 0; k < 4; k++) {
+            flags[i + k] = SlotFlags(chunk, i + k, (crossed >> k) & 1, (expired >> k) & 1);
+        }
+    }
+}
+#endif
+
+using SweepFn = void (*)(const EntityChunk &, long long, int, uint8_t *);
+
+static SweepFn ResolveSweep() {
+#ifdef KINEMATICS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SweepChunkAvx2;
+#endif
+    return SweepChunkScalar;
+}
+
+static const SweepFn sweep_impl = ResolveSweep();
+
+void SweepChunk(const EntityChunk &chunk, long long current_time, int cell_size, uint8_t *flags) {
+    sweep_impl(chunk, current_time, cell_size, flags);
+}
@@ -0,0 +1,28 @@
+#ifndef KINEMATICS_H
+#define KINEMATICS_H
+
+#include <cstdint>
+
+#include "entity_store.h"
+
+// Per-slot results of SweepChunk.
+enum SweepFlags : uint8_t {
+    SWEEP_CROSSED = 1,  // left the grid cell recorded in rows/cols
+    SWEEP_EXPIRED = 2,  // outlived its life_length
+    SWEEP_DEAD = 4,     // marked dead
+};
+
+// Advances every simulated entity of chunk to current_time in one pass over
+// the component arrays and writes its SweepFlags to flags[slot] (0 for
+// slots that are not simulated or need nothing). Simulated entities are
+// assumed to move linearly, as snowballs do. Cells are computed exactly as
+// Grid::Update does, for a grid of the given cell size.
+//
+// Uses AVX2 when the CPU has it and the entity state is full width (see
+// EntityCoord), and a scalar loop otherwise.
+void SweepChunk(const EntityChunk &chunk, long long current_time, int cell_size, uint8_t *flags);
+
+// The scalar implementation, exposed for comparison.
+void SweepChunkScalar(const EntityChunk &chunk, long long current_time, int cell_size, uint8_t *flags);
+
+#endif
@@ -1,29 +1,165 @@
 #include <iostream>
 #include <vector>
 #include <memory>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
 
 #include "server_worker.h"
+#include "grid_impl.h"
+#include "grid_stats.h"
 
-std::shared_ptr<Grid> grid;
+GridSlot grid_slot;
+thread_local std::shared_ptr<Grid> grid;
 
 thread_local std::unordered_set<uWS::WebSocket<false, true, PointerToPlayer>*> thread_clients;
 thread_local std::unordered_map<std::string, std::shared_ptr<GameObject>> thread_objects;
 
+// Maps that get a compile-time specialized grid (see FixedGrid), for the
+// cell sizes the tuner is most likely to pick. Cell sizes must be powers
+// of two.
+struct MapGrid {
+    int width, height, cell_size;
+    std::shared_ptr<Grid> (*make)();
+};
+
+template <int Width, int Height, int CellSize>
+std::shared_ptr<Grid> MakeFixedGrid() {
+    return std::make_shared<FixedGrid<Width, Height, CellSize>>();
+}
+
+const MapGrid kMapGrids[] = {
+    // client/assets/small-ski.tmj: 100x100 tiles of 16 px
+    {1600, 1600, 64, MakeFixedGrid<1600, 1600, 64>},
+    {1600, 1600, 128, MakeFixedGrid<1600, 1600, 128>},
+    {1600, 1600, 256, MakeFixedGrid<1600, 1600, 256>},
+    // client/assets/tiny-ski.tmj: 500x500 tiles of 16 px
+    {8000, 8000, 64, MakeFixedGrid<8000, 8000, 64>},
+    {8000, 8000, 128, MakeFixedGrid<8000, 8000, 128>},
+    {8000, 8000, 256, MakeFixedGrid<8000, 8000, 256>},
+};
+
+std::shared_ptr<Grid> MakeGrid(int width, int height, int cell_size) {
+    // Known maps use their specialized grid; anything else gets the runtime one.
+    for (const auto &map : kMapGrids) {
+        if (map.width == width && map.height == height && map.cell_size == cell_size) {
+            return map.make();
+        }
+    }
+
+    // Large worlds use the sparse grid so memory follows occupied cells.
+    long long cells = static_cast<long long>((height - 1) / cell_size + 1) * ((width - 1) / cell_size + 1);
+    GridMode mode = cells > constants::DENSE_GRID_MAX_CELLS ? GridMode::SPARSE : GridMode::DENSE;
+    return std::make_shared<Grid>(height, width, cell_size, mode);
+}
+
+// Resolves hits for the whole world once per tick (see CollisionPass),
+// then encodes every cell and publishes each occupied one to its topic on
+// every worker, since a cell's subscribers may be connected to any of them.
+void RunWorldTick(const std::vector<std::shared_ptr<ServerWorker>> &workers) {
+    auto next = std::chrono::steady_clock::now();
+    while (true) {
+        next += std::chrono::milliseconds(constants::COLLISION_TICK_MS);
+        std::this_thread::sleep_until(next);
+
+        auto current = grid_slot.Load();
+        long long current_time = thread_clock.Tick();
+        collision_pass.Run(*current, current_time);
+
+        auto frames = std::make_shared<std::vector<CellFrame>>();
+        current->EncodeBlobs(current_time, [&](int row, int col, const CellBlob &blob) {
+            frames->push_back(MakeCellFrame(current->get_cell_size(), row, col, blob));
+        });
+        if (frames->empty()) continue;
+        for (const auto &worker : workers) worker->Publish(frames);
+    }
+}
+
 int main(int argc, char *argv[]) {
     int workers_num = 4;
-    int grid_height = 1600, grid_width = 1600, grid_cell_size = 100;
+    int grid_height = 1600, grid_width = 1600, grid_cell_size = constants::DEFAULT_GRID_CELL_SIZE;
     int port = 12345;
+    const char *stats_path = nullptr;
+    const char *heatmap_path = nullptr;
+
+    // Optional world size override:
+    //   ./server <width> <height> [grid stats file] [grid heatmap file]
+    if (argc >= 3) {
+        grid_width = std::atoi(argv[1]);
+        grid_height = std::atoi(argv[2]);
+    }
+    if (argc >= 4) {
+        stats_path = argv[3];
+    }
+    if (argc >= 5) {
+        heatmap_path = argv[4];
+    }
+
+    // Occupancy of the current retune window, and of the whole session.
+    GridStats window_stats(grid_width, grid_height);
+    GridStats session_stats(grid_width, grid_height);
+
+    // Start from the cell size a recorded session recommends, if any.
+    if (stats_path) {
+        std::ifstream in(stats_path);
+        if (in && session_stats.Load(in) && session_stats.Recommend()) {
+            grid_cell_size = session_stats.Recommend();
+            std::cout << "Grid cell size " << grid_cell_size << " from " << stats_path << std::endl;
+        }
+    }
 
     std::vector<std::shared_ptr<ServerWorker>> workers;
-    grid = std::make_shared<Grid>(grid_height, grid_width, grid_cell_size);
+
+    grid_slot.Publish(MakeGrid(grid_width, grid_height, grid_cell_size));
 
     for (int i = 0; i < workers_num; i++) {
         workers.push_back(std::make_shared<ServerWorker>());
         workers[i]->Start(port);
     }
 
+    std::thread tick_thread(RunWorldTick, std::cref(workers));
+
     while (true) {
         std::this_thread::sleep_for(std::chrono::seconds(1));
+
+        auto current = grid_slot.Load();
+        current->Compact();
+        window_stats.Sample(*current);
+
+        if (window_stats.get_samples() < constants::GRID_RETUNE_INTERVAL) continue;
+
+        // Occupancy and lock contention per cell over the last window.
+        if (heatmap_path) {
+            std::ofstream out(heatmap_path);
+            out << CounterHeatmap(*current).dump() << std::endl;
+        }
+        current->ResetCounters();
+
+        for (size_t i = 0; i < workers.size(); i++) {
+            const auto &players = workers[i]->get_player_pool();
+            const auto &snowballs = workers[i]->get_snowball_pool();
+            std::cout << "Worker " << i << " pools: players " << players.get_in_use() << "/"
+                      << players.get_capacity() << " (peak " << players.get_high_water() << "), snowballs "
+                      << snowballs.get_in_use() << "/" << snowballs.get_capacity() << " (peak "
+                      << snowballs.get_high_water() << ")" << std::endl;
+        }
+
+        // Rebuild with a better cell size when players have regrouped enough
+        // to make it worthwhile; workers move their objects over next tick.
+        int best = window_stats.Recommend();
+        if (best && best != current->get_cell_size() &&
+            window_stats.QueryCost(best) <
+                (1 - constants::GRID_RETUNE_MIN_GAIN) * window_stats.QueryCost(current->get_cell_size())) {
+            std::cout << "Grid cell size " << current->get_cell_size() << " -> " << best << std::endl;
+            grid_slot.Publish(MakeGrid(grid_width, grid_height, best));
+        }
+
+        session_stats.Merge(window_stats);
+        window_stats.Reset();
+        if (stats_path) {
+            std::ofstream out(stats_path);
+            session_stats.Save(out);
+        }
     }
 
     return 0;
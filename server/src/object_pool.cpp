@@ -0,0 +1,48 @@
+#include "object_pool.h"
+
+ObjectPool::~ObjectPool() {
+    for (void *slab : slabs_) ::operator delete(slab, std::align_val_t(BLOCK_SIZE));
+}
+
+// Carves a new slab into blocks on the local free list.
+void ObjectPool::Grow() {
+    size_t blocks = constants::OBJECT_POOL_SLAB_BLOCKS;
+    auto *slab = static_cast<std::byte *>(::operator new(blocks * BLOCK_SIZE, std::align_val_t(BLOCK_SIZE)));
+    slabs_.push_back(slab);
+
+    for (size_t i = blocks; i-- > 0;) {
+        auto *block = reinterpret_cast<FreeBlock *>(slab + i * BLOCK_SIZE);
+        block->next = local_free_;
+        local_free_ = block;
+    }
+    capacity_.fetch_add(blocks, std::memory_order_relaxed);
+}
+
+void *ObjectPool::Allocate() {
+    if (!local_free_) local_free_ = remote_free_.exchange(nullptr, std::memory_order_acquire);
+    if (!local_free_) Grow();
+
+    FreeBlock *block = local_free_;
+    local_free_ = block->next;
+
+    size_t in_use = in_use_.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (in_use > high_water_.load(std::memory_order_relaxed)) high_water_.store(in_use, std::memory_order_relaxed);
+    return block;
+}
+
+void ObjectPool::Deallocate(void *p) {
+    auto *block = static_cast<FreeBlock *>(p);
+    in_use_.fetch_sub(1, std::memory_order_relaxed);
+
+    if (std::this_thread::get_id() == owner_) {
+        block->next = local_free_;
+        local_free_ = block;
+        return;
+    }
+
+    // Only the owner takes from this stack, and it takes all of it at once,
+    // so pushes cannot suffer from ABA.
+    block->next = remote_free_.load(std::memory_order_relaxed);
+    while (!remote_free_.compare_exchange_weak(block->next, block, std::memory_order_release,
+                                               std::memory_order_relaxed)) {}
+}
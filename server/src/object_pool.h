@@ -0,0 +1,90 @@
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "constants.h"
+
+// Pool of fixed-size blocks owned by one worker thread.
+//
+// The owner allocates and frees through a plain free list. Objects are
+// often released on other threads (the last shared_ptr copy may sit in
+// another worker's query buffer), so those frees are pushed onto a
+// lock-free stack that the owner drains when its own list runs out.
+// Memory grows in slabs and is kept for reuse; it is released only when
+// the pool is destroyed, which must outlive every block handed out.
+class ObjectPool {
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+
+    FreeBlock *local_free_ = nullptr;
+    std::atomic<FreeBlock *> remote_free_{nullptr};
+    std::vector<void *> slabs_;
+    std::thread::id owner_;
+
+    std::atomic<size_t> capacity_{0}, in_use_{0}, high_water_{0};
+
+    void Grow();
+
+public:
+    static constexpr size_t BLOCK_SIZE = constants::OBJECT_POOL_BLOCK_SIZE;
+
+    ObjectPool() = default;
+    ~ObjectPool();
+
+    ObjectPool(const ObjectPool &) = delete;
+    ObjectPool &operator=(const ObjectPool &) = delete;
+
+    // Makes the calling thread the owner; call before the first Allocate.
+    void BindToCurrentThread() { owner_ = std::this_thread::get_id(); }
+
+    // Owner thread only.
+    void *Allocate();
+    // Any thread.
+    void Deallocate(void *block);
+
+    // Blocks carved out so far, blocks currently handed out, and the most
+    // ever handed out at once.
+    inline size_t get_capacity() const { return capacity_.load(std::memory_order_relaxed); }
+    inline size_t get_in_use() const { return in_use_.load(std::memory_order_relaxed); }
+    inline size_t get_high_water() const { return high_water_.load(std::memory_order_relaxed); }
+};
+
+// Allocator for std::allocate_shared that places the object together with
+// its control block in one pool block.
+template <typename T>
+struct PoolAllocator {
+    using value_type = T;
+
+    ObjectPool *pool;
+
+    explicit PoolAllocator(ObjectPool *pool) : pool(pool) {}
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &other) : pool(other.pool) {}
+
+    T *allocate(size_t n) {
+        static_assert(sizeof(T) <= ObjectPool::BLOCK_SIZE, "Raise OBJECT_POOL_BLOCK_SIZE for this type");
+        static_assert(alignof(T) <= ObjectPool::BLOCK_SIZE, "Pool blocks are aligned to their size");
+        if (n != 1) return static_cast<T *>(::operator new(n * sizeof(T)));
+        return static_cast<T *>(pool->Allocate());
+    }
+
+    void deallocate(T *p, size_t n) {
+        if (n != 1) {
+            ::operator delete(p);
+            return;
+        }
+        pool->Deallocate(p);
+    }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U> &other) const { return pool == other.pool; }
+};
+
+#endif
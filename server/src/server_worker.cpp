@@ -2,13 +2,33 @@
 
 using json = nlohmann::json;
 
+// This tick's encoded entity states, shared by all of the thread's views.
+static thread_local StateCache state_cache;
+
+// Connection of each of this thread's players, for delivering hits.
+static thread_local std::unordered_map<const GameObject *, uWS::WebSocket<false, true, PointerToPlayer> *>
+    thread_sockets;
+
+// Bounds a client-reported extent, which widens every grid query that
+// could reach the object. NaN and negative sizes become 0.
+static double ClampSize(double size) {
+    return size > 0 ? std::min(size, constants::MAX_OBJECT_SIZE) : 0.0;
+}
+
 ServerWorker::ServerWorker() {}
 
+std::shared_ptr<Player> ServerWorker::NewPlayer() {
+    return std::allocate_shared<Player>(PoolAllocator<Player>(&player_pool_));
+}
+
+std::shared_ptr<Snowball> ServerWorker::NewSnowball(std::string name) {
+    return std::allocate_shared<Snowball>(PoolAllocator<Snowball>(&snowball_pool_), std::move(name));
+}
+
 // Sends a pong response for a "ping" message.
 void ServerWorker::handlePing(auto *ws, const json &message, uWS::OpCode opCode) {
     long long clientTime = message.value("clientTime", 0LL);
-    auto now = std::chrono::system_clock::now();
-    auto serverTime = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+    long long serverTime = TickClock::ToWall(thread_clock.Now());
 
     json pongMsg = {
         {"messageType", "pong"},
@@ -20,13 +40,21 @@ void ServerWorker::handlePing(auto *ws, const json &message, uWS::OpCode opCode)
 }
 
 // Processes a "join" message.
-void ServerWorker::handleJoin(auto * /*ws*/, const json &message, std::shared_ptr<Player> player_ptr) {
+void ServerWorker::handleJoin(auto *ws, const json &message, std::shared_ptr<Player> player_ptr) {
+    // A repeated join renames the player, which must not happen while other
+    // threads can read its name through the grid.
+    grid->Remove(player_ptr);
+
     // Set the player's ID and attributes using default values if keys are missing.
-    player_ptr->set_id(message.value("id", "unknown"));
+    player_ptr->set_name(message.value("id", "unknown"));
 
     double x = 0.0, y = 0.0;
     int health = message.value("health", 100);
     double size = message.value("size", 20.0);
+    // Optional team number; teammates cannot hurt each other.
+    int team = message.value("team", -1);
+    // Binary protocol version the client speaks, if any (see wire.h).
+    int protocol = message.value("protocol", 0);
 
     // Extract position if provided.
     if (message.contains("position") &&
@@ -39,10 +67,64 @@ void ServerWorker::handleJoin(auto * /*ws*/, const json &message, std::shared_pt
     player_ptr->set_health(health);
     player_ptr->set_x(x);
     player_ptr->set_y(y);
-    player_ptr->set_size(size);
+    player_ptr->set_size(ClampSize(size));
+    player_ptr->set_team_mask(team >= 0 && team < 32 ? 1u << team : 0);
 
     // Insert the player into the grid.
     grid->Insert(player_ptr);
+
+    // Answer a protocol request with the version both sides will use.
+    if (protocol) {
+        ws->getUserData()->protocol = protocol == WIRE_VERSION ? WIRE_VERSION : 0;
+        json welcome = {
+            {"messageType", "welcome"},
+            {"protocol", ws->getUserData()->protocol}
+        };
+        ws->send(welcome.dump(), uWS::OpCode::TEXT);
+    }
+}
+
+// Moves the connection's player to a reported position.
+void ServerWorker::applyPlayerMove(std::shared_ptr<Player> player_ptr, double x, double y) {
+    player_ptr->set_x(x);
+    player_ptr->set_y(y);
+    grid->Update(player_ptr, 0);
+}
+
+// Creates or updates one of the connection's snowballs.
+void ServerWorker::applySnowballUpdate(const SnowballUpdate &update, std::shared_ptr<Player> player_ptr) {
+    bool is_new = false;
+    std::shared_ptr<Snowball> snowball_ptr;
+
+    if (!thread_objects.count(update.id)) {
+        snowball_ptr = NewSnowball(update.id);
+        // The thrower is the connection's player, recorded once here.
+        snowball_ptr->set_owner(player_ptr->get_id());
+        snowball_ptr->set_team_mask(player_ptr->get_team_mask());
+        snowball_ptr->set_simulated(true);
+        thread_objects[update.id] = snowball_ptr;
+        is_new = true;
+    }
+    else {
+        snowball_ptr = std::static_pointer_cast<Snowball>(thread_objects[update.id]);
+    }
+
+    snowball_ptr->set_x(update.x);
+    snowball_ptr->set_y(update.y);
+    snowball_ptr->set_vx(update.vx);
+    snowball_ptr->set_vy(update.vy);
+    snowball_ptr->set_size(ClampSize(update.size));
+    snowball_ptr->set_time_update(update.time_update);
+    snowball_ptr->set_life_length(update.life_length);
+    snowball_ptr->set_charging(update.charging);
+    snowball_ptr->set_damage(update.damage);
+
+    if (is_new) {
+        grid->Insert(snowball_ptr);
+    } else {
+        // Keep the grid's cached record in sync with the new state.
+        grid->Update(snowball_ptr, update.time_update);
+    }
 }
 
 // Processes a "movement" message.
@@ -60,58 +142,90 @@ void ServerWorker::handleMovement(auto * /*ws*/, const json &message, std::share
             new_y = message["position"]["y"].get<double>();
         }
 
-        player_ptr->set_x(new_x);
-        player_ptr->set_y(new_y);
-        grid->Update(player_ptr, 0);
+        applyPlayerMove(player_ptr, new_x, new_y);
     } else if (message["objectType"] == "snowball") {
         // Handle snowball movement.
-        std::string snowball_id = message.value("id", "unknown");
-        bool is_new = false;
-        std::shared_ptr<Snowball> snowball_ptr;
-
-        if (!thread_objects.count(snowball_id)) {
-            snowball_ptr = std::make_shared<Snowball>(snowball_id, "snowball");
-            thread_objects[snowball_id] = snowball_ptr;
-            is_new = true;
-        }
-        else {
-            snowball_ptr = std::static_pointer_cast<Snowball>(thread_objects[snowball_id]);
-        }
-
-        // std::cout << "thread_object's size: " << thread_objects_.size() << std::endl;
-
-        double x = 0.0, y = 0.0, vx = 0.0, vy = 0.0;
-        double size = message.value("size", 1.0);
-        long long time_update = message.value("timeEmission", 0LL);
-        long long life_length = message.value("lifeLength", static_cast<long long>(4e18));
-        int damage = message.value("damage", 5);
-        bool charging = message.value("charging", false);
+        SnowballUpdate update;
+        update.id = message.value("id", "unknown");
+        update.size = message.value("size", 1.0);
+        // Clients stamp snowballs with wall-clock time; charging snowballs
+        // carry no stamp and start now.
+        update.time_update = message.contains("timeEmission")
+            ? TickClock::FromWall(message["timeEmission"].get<long long>())
+            : thread_clock.Now();
+        update.life_length = message.value("lifeLength", update.life_length);
+        update.damage = message.value("damage", 5);
+        update.charging = message.value("charging", false);
 
         if (message.contains("position") &&
             message["position"].contains("x") &&
             message["position"].contains("y")) {
-            x = message["position"]["x"].get<double>();
-            y = message["position"]["y"].get<double>();
+            update.x = message["position"]["x"].get<double>();
+            update.y = message["position"]["y"].get<double>();
         }
         if (message.contains("velocity") &&
             message["velocity"].contains("x") &&
             message["velocity"].contains("y")) {
-            vx = message["velocity"]["x"].get<double>();
-            vy = message["velocity"]["y"].get<double>();
+            update.vx = message["velocity"]["x"].get<double>();
+            update.vy = message["velocity"]["y"].get<double>();
         }
 
-        snowball_ptr->set_x(x);
-        snowball_ptr->set_y(y);
-        snowball_ptr->set_vx(vx);
-        snowball_ptr->set_vy(vy);
-        snowball_ptr->set_size(size);
-        snowball_ptr->set_time_update(time_update);
-        snowball_ptr->set_life_length(life_length);
-        snowball_ptr->set_charging(charging);
-        snowball_ptr->set_damage(damage);
-
-        if (is_new) {
-            grid->Insert(snowball_ptr);
+        applySnowballUpdate(update, player_ptr);
+    }
+}
+
+// Processes a binary frame (see wire.h) from a client that negotiated it.
+void ServerWorker::handleWireMessage(auto *ws, std::string_view data) {
+    if (!ws->getUserData()->protocol) return;
+    auto player_ptr = ws->getUserData()->player;
+
+    WireReader in(data);
+    if (in.GetU8() != WIRE_VERSION) return;
+
+    // Records have no length prefix, so an unknown or truncated record
+    // ends the frame.
+    while (in.Ok() && !in.AtEnd()) {
+        switch (static_cast<WireRecord>(in.GetU8())) {
+            case WireRecord::PING: {
+                double client_time = in.GetF64();
+                if (!in.Ok()) return;
+                WireWriter pong;
+                pong.PutU8(WIRE_VERSION);
+                pong.PutU8(static_cast<uint8_t>(WireRecord::PONG));
+                pong.PutF64(client_time);
+                pong.PutF64(static_cast<double>(TickClock::ToWall(thread_clock.Now())));
+                ws->send(pong.get_data(), uWS::OpCode::BINARY);
+                break;
+            }
+            case WireRecord::PLAYER_MOVE: {
+                double x = in.GetF32();
+                double y = in.GetF32();
+                if (!in.Ok()) return;
+                applyPlayerMove(player_ptr, x, y);
+                break;
+            }
+            case WireRecord::SNOWBALL_MOVE: {
+                SnowballUpdate update;
+                update.id = in.GetString();
+                uint8_t flags = in.GetU8();
+                update.x = in.GetF32();
+                update.y = in.GetF32();
+                update.vx = in.GetF32();
+                update.vy = in.GetF32();
+                update.size = in.GetF32();
+                update.damage = in.GetU16();
+                // 0 when the client had no emission time (charging).
+                long long time_emission = static_cast<long long>(in.GetF64());
+                update.time_update = time_emission ? TickClock::FromWall(time_emission) : thread_clock.Now();
+                uint32_t life_length = in.GetU32();
+                if (!in.Ok()) return;
+                update.charging = flags & WIRE_CHARGING;
+                if (life_length != WIRE_NO_EXPIRY) update.life_length = life_length;
+                applySnowballUpdate(update, player_ptr);
+                break;
+            }
+            default:
+                return;
         }
     }
 }
@@ -120,6 +234,14 @@ void ServerWorker::handleMovement(auto * /*ws*/, const json &message, std::share
 // Refactored HandleMessage implementation
 //------------------------------------------------------------------------------
 void ServerWorker::HandleMessage(auto *ws, std::string_view str_message, uWS::OpCode opCode) {
+    thread_clock.Tick();
+    SyncGrid();
+
+    if (opCode == uWS::OpCode::BINARY) {
+        handleWireMessage(ws, str_message);
+        return;
+    }
+
     json message = json::parse(str_message);
     std::string type = message.value("type", "");
 
@@ -151,39 +273,148 @@ void ServerWorker::Start(int port) {
     worker_thread_ = std::thread(&ServerWorker::StartServer, this, port);
 }
 
-std::string ExtractPlayerId(const std::string& snowballId) {
-    size_t firstUnderscore = snowballId.find('_');
-    size_t secondUnderscore = snowballId.find('_', firstUnderscore + 1);
+void SyncGrid() {
+    thread_local uint64_t generation = 0;
+    uint64_t published = grid_slot.get_generation();
+    if (generation == published) return;
 
-    if (firstUnderscore == std::string::npos || secondUnderscore == std::string::npos) {
-        return "not_snowball";
+    auto next = grid_slot.Load();
+    generation = published;
+    if (next == grid) return;
+    grid = std::move(next);
+
+    // Players enter the grid when they join.
+    for (auto *ws : thread_clients) {
+        auto &player_ptr = ws->getUserData()->player;
+        if (player_ptr->get_name() != "unknown") grid->Insert(player_ptr);
+    }
+    for (const auto &[id, obj] : thread_objects) {
+        if (obj && !obj->get_is_dead()) grid->Insert(obj);
     }
+}
+
+CellFrame MakeCellFrame(int cell_size, int row, int col, const CellBlob &blob) {
+    WireWriter out;
+    out.PutU8(WIRE_VERSION);
+    out.PutRaw(blob.arrivals.get_data());
+    PutCellRecord(out, row, col);
+    out.PutRaw(blob.records.get_data());
+    return {CellTopic(cell_size, row, col), out.get_data()};
+}
 
-    return snowballId.substr(firstUnderscore + 1, secondUnderscore - firstUnderscore - 1);
+void ServerWorker::Publish(CellFrames frames) {
+    uWS::Loop *loop = loop_.load(std::memory_order_acquire);
+    if (!loop) return;
+    loop->defer([this, frames = std::move(frames)]() {
+        for (const auto &frame : *frames) app_->publish(frame.topic, frame.data, uWS::OpCode::BINARY);
+    });
 }
 
+// Keeps the player up to date with what it can see. Binary clients are
+// subscribed to the topics of the cells around them, which every worker
+// publishes once per tick (see ServerWorker::Publish); here they only
+// follow the player, and cells new to the view are sent directly so the
+// client has their names and states before the next publish. Cells cover
+// more than the view and include the player itself. JSON clients get a
+// "snapshot" message listing the objects. Hits are resolved separately,
+// once per tick for the whole world (see CollisionPass), so this is
+// replication only.
 void UpdatePlayerView(auto *ws, auto player_ptr) {
+    // Reused across ticks so the steady-state view update does not allocate.
+    thread_local std::vector<std::shared_ptr<GameObject>> neighbors;
+    thread_local WireWriter frame;
+    thread_local std::string text;
+    thread_local std::unordered_set<uint64_t> visible;
 
     double lower_y = player_ptr->get_y() - (constants::FIXED_VIEW_HEIGHT);
     double upper_y = lower_y + 2 * constants::FIXED_VIEW_HEIGHT;
     double left_x = player_ptr->get_x() - (constants::FIXED_VIEW_WIDTH);
     double right_x = left_x + 2 * constants::FIXED_VIEW_WIDTH;
-    
-    std::vector<std::shared_ptr<GameObject>> neighbors = grid->Search(lower_y, upper_y, left_x, right_x);
-     
-    for (auto obj : neighbors) {
-        if (obj->get_id() != player_ptr->get_id()) {
-            if (obj->get_damage() && ExtractPlayerId(obj->get_id()) != player_ptr->get_id() &&
-                obj->Collide(player_ptr)) {
-                player_ptr->Hurt(ws, obj->get_damage());
-            } else {
-                obj->SendMessageToClient(ws, "movement");
+
+    auto *client = ws->getUserData();
+
+    if (client->protocol) {
+        CellRange view = grid->CellsIn(lower_y, upper_y, left_x, right_x);
+        CellRange old = client->view;
+        if (view == old) return;
+
+        // A retuned grid has new topics, so every old one is dropped.
+        bool regrid = view.cell_size != old.cell_size;
+        for (int r = old.lower_row; r <= old.upper_row; r++) {
+            for (int c = old.left_col; c <= old.right_col; c++) {
+                if (regrid || !view.Contains(r, c)) ws->unsubscribe(CellTopic(old.cell_size, r, c));
             }
         }
+        if (regrid) old = CellRange{};
+        for (int r = view.lower_row; r <= view.upper_row; r++) {
+            for (int c = view.left_col; c <= view.right_col; c++) {
+                if (!old.Contains(r, c)) ws->subscribe(CellTopic(view.cell_size, r, c));
+            }
+        }
+        client->view = view;
+
+        // Cells new to the view go out directly. The entities of every
+        // cell in view become the named set, so entities that left the
+        // view are forgotten and named again if they come back.
+        frame.Clear();
+        frame.PutU8(WIRE_VERSION);
+        visible.clear();
+        grid->ForEachCellBlob(lower_y, upper_y, left_x, right_x, [&](int row, int col, const CellBlob &blob) {
+            bool fresh = !old.Contains(row, col);
+            // Names go first; the client needs them to read the records.
+            for (size_t i = 0; i < blob.ids.size(); i++) {
+                uint64_t key = WireKey(blob.ids[i]);
+                visible.insert(key);
+                if (fresh && !client->named.count(key)) PutNameRecord(frame, blob.ids[i].index, blob.names[i]);
+            }
+            if (!fresh) return;
+            PutCellRecord(frame, row, col);
+            frame.PutRaw(blob.records.get_data());
+        });
+        client->named.swap(visible);
+        if (frame.get_data().size() > 1) ws->send(frame.get_data(), uWS::OpCode::BINARY);
+        return;
     }
+
+    grid->Search(lower_y, upper_y, left_x, right_x, neighbors);
+    long long current_time = thread_clock.Now();
+
+    // {"messageType":"snapshot","objects":[...]}, spliced from cached objects.
+    text = R"({"messageType":"snapshot","objects":[)";
+    bool empty = true;
+    for (const auto &obj : neighbors) {
+        if (obj->get_id() == player_ptr->get_id()) continue;
+        if (!empty) text += ',';
+        text += state_cache.Json(*obj, current_time);
+        empty = false;
+    }
+    if (empty) return;
+    text += "]}";
+    ws->send(text, uWS::OpCode::TEXT);
+}
+
+// Applies the hits the collision pass found against this worker's players.
+static void ApplyHits() {
+    thread_local HitInbox &inbox = collision_pass.Inbox(EntityStore::ThreadPartition());
+    thread_local std::vector<HitEvent> events;
+    inbox.Drain(events);
+
+    for (const auto &event : events) {
+        auto it = thread_sockets.find(event.target.get());
+        if (it == thread_sockets.end() || event.target->get_is_dead()) continue;
+        event.target->Hurt(it->second, event.damage, thread_clock.Now());
+        // Publish the new health to the grid's record.
+        grid->Update(event.target, thread_clock.Now());
+    }
+    events.clear();
 }
 
 void HandleThreadClients(struct us_timer_t * /*t*/) {
+    thread_clock.Tick();
+    SyncGrid();
+    ApplyHits();
+    state_cache.Reset();
+
     auto clients_copy = thread_clients;
     for (auto *ws : clients_copy) {
         auto player_ptr = ws->getUserData()->player;
@@ -192,37 +423,67 @@ void HandleThreadClients(struct us_timer_t * /*t*/) {
             thread_clients.erase(ws);
             return;
         }
-        UpdatePlayerView(ws, player_ptr);
+        // Corked so the view frame leaves in one write.
+        ws->cork([&]() { UpdatePlayerView(ws, player_ptr); });
     }
 }
 void HandleThreadObjects(struct us_timer_t * /*t*/) {
-    auto objects_copy = thread_objects;
-    
-    for (auto &[id, obj] : objects_copy) {
-        if (obj) { 
-            auto now = std::chrono::system_clock::now();
-            auto current_time = std::chrono::duration_cast<std::chrono::milliseconds>(
-                now.time_since_epoch()).count();
-                
-            if (obj->get_is_dead()) {
-                thread_objects.erase(id);
-            } else if (obj->Expired(current_time)) {
-                thread_objects.erase(id);
-                grid->Remove(obj);
+    thread_clock.Tick();
+    SyncGrid();
+
+    long long current_time = thread_clock.Now();
+
+    thread_local std::vector<std::shared_ptr<GameObject>> moving;
+    thread_local std::vector<EntityChunk *> chunks;
+    thread_local std::vector<uint8_t> flags(ENTITY_CHUNK_SIZE);
+    moving.clear();
+
+    // This worker's snowballs live in its own entity chunks; one sweep per
+    // chunk advances all of them and flags the few that need attention.
+    // Only objects that left their cell go back to the grid.
+    entity_store.PartitionChunks(EntityStore::ThreadPartition(), chunks);
+    for (EntityChunk *chunk : chunks) {
+        SweepChunk(*chunk, current_time, grid->get_cell_size(), flags.data());
+
+        for (uint32_t slot = 0; slot < ENTITY_CHUNK_SIZE; slot++) {
+            if (!flags[slot]) continue;
+
+            auto it = thread_objects.find(chunk->names[slot]);
+            if (it == thread_objects.end() || !it->second) {
+                chunk->simulated[slot] = false;
+                continue;
+            }
+
+            // Dead and expired objects leave the grid too, so its handle no
+            // longer keeps them (and their pool block and entity) alive.
+            if (flags[slot] & (SWEEP_DEAD | SWEEP_EXPIRED)) {
+                chunk->simulated[slot] = false;
+                grid->Remove(it->second);
+                thread_objects.erase(it);
             } else {
-                grid->Update(obj, current_time);
+                moving.push_back(it->second);
             }
         }
     }
+
+    grid->UpdateMany(moving, current_time);
 }
 
 void ServerWorker::StartServer(int port) {
+    // Entities created on this thread get chunks of their own (see
+    // HandleThreadObjects).
+    entity_store.BindThreadPartition();
+    player_pool_.BindToCurrentThread();
+    snowball_pool_.BindToCurrentThread();
+    thread_clock.Tick();
+    SyncGrid();
+
     uWS::App app = uWS::App()
         .ws<PointerToPlayer>("/*", {
-            .open = [](auto *ws) {
-                ws->getUserData()->player = std::make_shared<Player>();
-                ws->getUserData()->player->set_type("player");
+            .open = [this](auto *ws) {
+                ws->getUserData()->player = NewPlayer();
                 thread_clients.insert(ws);
+                thread_sockets[ws->getUserData()->player.get()] = ws;
                 std::cout << "Client connected!" << std::endl;
             },
             .message = [this](auto *ws, std::string_view message, uWS::OpCode opCode) {
@@ -231,6 +492,7 @@ void ServerWorker::StartServer(int port) {
             .close = [](auto *ws, int /*code*/, std::string_view /*message*/) {
                 grid->Remove(ws->getUserData()->player);
                 thread_clients.erase(ws);
+                thread_sockets.erase(ws->getUserData()->player.get());
                 std::cout << "Client disconnected!" << std::endl;
             }
         }).listen(port, [&](auto *listenSocket) {
@@ -241,6 +503,10 @@ void ServerWorker::StartServer(int port) {
             }
         });
 
+    // Cell frames from the world tick are published through this app.
+    app_ = &app;
+    loop_.store(uWS::Loop::get(), std::memory_order_release);
+
     struct us_loop_t *loop = (struct us_loop_t *) uWS::Loop::get();
     struct us_timer_t *playerTimer = us_create_timer(loop, 0, 0);
 
@@ -2,11 +2,14 @@
 #define server_worker_h
 
 #include <iostream>
+#include <bit>
 #include <string>
 #include <chrono>
 #include <uWebSockets/App.h>
 #include <unordered_set>
 #include <memory>
+#include <mutex>
+#include <atomic>
 #include <thread>
 
 #include "nlohmann/json.hpp"
@@ -14,25 +17,100 @@
 #include "grid.h"
 #include "game_object.h"
 #include "constants.h"
+#include "object_pool.h"
+#include "kinematics.h"
+#include "collision_pass.h"
+#include "tick_clock.h"
+#include "state_cache.h"
 
-extern std::shared_ptr<Grid> grid;
+// The grid all workers index into. main() may replace it between ticks
+// (e.g. with a retuned cell size); each thread switches over in SyncGrid.
+class GridSlot {
+    std::mutex mtx_;
+    std::shared_ptr<Grid> grid_;
+    std::atomic<uint64_t> generation_{0};
+public:
+    void Publish(std::shared_ptr<Grid> next) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        grid_ = std::move(next);
+        generation_.fetch_add(1, std::memory_order_release);
+    }
+    std::shared_ptr<Grid> Load() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return grid_;
+    }
+    inline uint64_t get_generation() const { return generation_.load(std::memory_order_acquire); }
+};
+
+extern GridSlot grid_slot;
+
+// This thread's view of the published grid.
+extern thread_local std::shared_ptr<Grid> grid;
+
+// Switches this thread to the latest published grid, moving the objects it
+// owns into it. Objects owned by other workers appear there at their
+// owners' next tick.
+void SyncGrid();
 
 extern thread_local std::unordered_set<uWS::WebSocket<false, true, PointerToPlayer>*> thread_clients;
 extern thread_local std::unordered_map<std::string, std::shared_ptr<GameObject>> thread_objects;
 
+// A client's report of one of its snowballs, in either protocol.
+struct SnowballUpdate {
+    std::string id;
+    double x = 0.0, y = 0.0, vx = 0.0, vy = 0.0;
+    double size = 1.0;
+    // On the tick clock.
+    long long time_update = 0;
+    long long life_length = ENTITY_NEVER_MS;
+    int damage = 5;
+    bool charging = false;
+};
+
+// One tick's binary frame for a cell topic (see CellTopic): a version byte,
+// the cell's arrivals' NAME records, then a CELL record and its STATE records.
+struct CellFrame {
+    std::string topic;
+    std::string data;
+};
+
+using CellFrames = std::shared_ptr<const std::vector<CellFrame>>;
+
+CellFrame MakeCellFrame(int cell_size, int row, int col, const CellBlob &blob);
+
 class ServerWorker {
     std::thread worker_thread_;
+    // Storage for the players and snowballs this worker creates.
+    ObjectPool player_pool_, snowball_pool_;
+    // Set by the worker thread once its app exists; app_ is only touched
+    // on that thread.
+    std::atomic<uWS::Loop *> loop_{nullptr};
+    uWS::App *app_ = nullptr;
 public:
     ServerWorker();
     void Start(int port);
+
+    // Publishes each frame to its topic on this worker's app. May be called
+    // from any thread; the publish runs on the worker's loop.
+    void Publish(CellFrames frames);
+
+    inline const ObjectPool &get_player_pool() const { return player_pool_; }
+    inline const ObjectPool &get_snowball_pool() const { return snowball_pool_; }
 protected:
     void StartServer(int port);
 
+    std::shared_ptr<Player> NewPlayer();
+    std::shared_ptr<Snowball> NewSnowball(std::string name);
+
     void HandleMessage(auto *ws, std::string_view str_message, uWS::OpCode opCode);
 
     void handlePing(auto *ws, const json &message, uWS::OpCode opCode);
     void handleJoin(auto *ws, const json &message, std::shared_ptr<Player> player_ptr);
     void handleMovement(auto *ws, const json &message, std::shared_ptr<Player> player_ptr);
+    void handleWireMessage(auto *ws, std::string_view data);
+
+    void applyPlayerMove(std::shared_ptr<Player> player_ptr, double x, double y);
+    void applySnowballUpdate(const SnowballUpdate &update, std::shared_ptr<Player> player_ptr);
 };
 
 #endif
@@ -0,0 +1,16 @@
+#include "state_cache.h"
+
+void StateCache::Reset() {
+    json_.clear();
+    json_spans_.clear();
+}
+
+std::string_view StateCache::Json(const GameObject &obj, long long current_time) {
+    auto [it, inserted] = json_spans_.try_emplace(WireKey(obj.get_id()));
+    if (inserted) {
+        std::string fragment = obj.StateJson("movement", current_time).dump();
+        it->second = {static_cast<uint32_t>(json_.size()), static_cast<uint32_t>(fragment.size())};
+        json_ += fragment;
+    }
+    return std::string_view(json_).substr(it->second.first, it->second.second);
+}
@@ -0,0 +1,32 @@
+#ifndef STATE_CACHE_H
+#define STATE_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include "game_object.h"
+
+// Encoded JSON "movement" state of the entities one worker replicates to
+// its JSON clients in a tick. Each entity is encoded at most once however
+// many of the worker's players see it; snapshots are assembled from these
+// fragments. (Binary clients get pre-encoded cell blobs instead.)
+class StateCache {
+    // Fragments are packed into one arena, which keeps its capacity across
+    // ticks; the map holds (offset, length) by WireKey.
+    using Span = std::pair<uint32_t, uint32_t>;
+    std::string json_;
+    std::unordered_map<uint64_t, Span> json_spans_;
+
+public:
+    // Forgets the previous tick's fragments.
+    void Reset();
+
+    // The dumped message object. Views stay valid until the next Reset or
+    // the next miss.
+    std::string_view Json(const GameObject &obj, long long current_time);
+};
+
+#endif
@@ -0,0 +1,21 @@
+#include "tick_clock.h"
+
+thread_local TickClock thread_clock;
+
+std::atomic<long long> TickClock::latest_{TickClock::SteadyMillis()};
+
+// Wall-clock time minus steady time, fixed once so that later wall-clock
+// jumps do not reach the simulation.
+static long long WallOffset() {
+    static const long long offset = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count() - TickClock::SteadyMillis();
+    return offset;
+}
+
+long long TickClock::ToWall(long long tick_ms) {
+    return tick_ms + WallOffset();
+}
+
+long long TickClock::FromWall(long long wall_ms) {
+    return wall_ms - WallOffset();
+}
@@ -0,0 +1,44 @@
+#ifndef TICK_CLOCK_H
+#define TICK_CLOCK_H
+
+#include <atomic>
+#include <chrono>
+
+// Milliseconds on the monotonic clock: the time base of the simulation.
+// Every time_update, expiry check and grid query runs on it, so wall-clock
+// adjustments cannot move or expire objects. Wall-clock milliseconds only
+// appear in messages and are converted at that boundary.
+//
+// Each thread samples the clock at the top of every timer callback and
+// message handler (Tick), and every phase of that dispatch reads the same
+// timestamp (Now). A sample taken before the loop blocks in epoll_wait
+// would be stale by the time the handler runs.
+class TickClock {
+    long long now_ = 0;
+    static std::atomic<long long> latest_;
+
+public:
+    static long long SteadyMillis() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Conversions for timestamps sent to or received from clients.
+    static long long ToWall(long long tick_ms);
+    static long long FromWall(long long wall_ms);
+
+    long long Tick() {
+        now_ = SteadyMillis();
+        latest_.store(now_, std::memory_order_relaxed);
+        return now_;
+    }
+    inline long long Now() const { return now_; }
+    // The latest sample taken by any thread, or the process start time
+    // before the first one.
+    static long long Latest() { return latest_.load(std::memory_order_relaxed); }
+};
+
+// The calling thread's clock.
+extern thread_local TickClock thread_clock;
+
+#endif
@@ -0,0 +1,208 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+// Binary wire protocol, used by clients that ask for it in their "join"
+// message; the others keep talking JSON, which stays handy for debugging.
+//
+// A frame is one WIRE_VERSION byte followed by records. Each record starts
+// with a WireRecord byte and has a fixed layout: integers and floats are
+// little-endian, entity IDs and string lengths are LEB128 varints.
+//
+//   NAME           varint id, varint length, bytes
+//                  (sent before the first STATE of an entity to a client)
+//   STATE          u8 WireMessage, varint id, u8 flags (WireObjectFlags),
+//                  f32 x, y, vx, vy, size, u32 life length ms, i16 health
+//   PONG           f64 client time, f64 server time (wall-clock ms)
+//   PING           f64 client time
+//   PLAYER_MOVE    f32 x, y
+//   SNOWBALL_MOVE  varint length + id bytes, u8 flags (WIRE_CHARGING),
+//                  f32 x, y, vx, vy, size, u16 damage,
+//                  f64 emission time (wall-clock ms, 0 if none), u32 life length ms
+//   CELL           i32 row, col: the STATE records up to the next CELL are
+//                  everything grid cell (row, col) holds; none if it emptied
+//
+// IDs in NAME and STATE are entity indices; NAME tells the client which
+// string ID an index stands for, until the index is named again.
+constexpr uint8_t WIRE_VERSION = 2;
+
+enum class WireRecord : uint8_t {
+    NAME = 1,
+    STATE = 2,
+    PONG = 3,
+    PING = 4,
+    PLAYER_MOVE = 5,
+    SNOWBALL_MOVE = 6,
+    CELL = 7
+};
+
+// messageType of a STATE record.
+enum class WireMessage : uint8_t {
+    MOVEMENT = 0,
+    HIT = 1
+};
+
+// Low two bits: the ObjectType. Then:
+constexpr uint8_t WIRE_CHARGING = 1 << 2;
+constexpr uint8_t WIRE_DEAD = 1 << 3;
+
+// Life length meaning "never expires" (saturates on the way out too).
+constexpr uint32_t WIRE_NO_EXPIRY = UINT32_MAX;
+
+// Fields of a STATE record, taken from wherever the caller has a
+// consistent copy of the entity's state.
+struct WireState {
+    uint32_t index = 0;
+    uint8_t flags = 0;
+    float x = 0, y = 0, vx = 0, vy = 0, size = 0;
+    uint32_t life_length = WIRE_NO_EXPIRY;
+    int16_t health = 0;
+};
+
+// Appends little-endian fields to a byte string.
+class WireWriter {
+    std::string buf_;
+
+    template <typename T>
+    void PutLE(T v) {
+        for (size_t i = 0; i < sizeof(T); i++) buf_.push_back(static_cast<char>((v >> (8 * i)) & 0xff));
+    }
+
+public:
+    void PutU8(uint8_t v) { buf_.push_back(static_cast<char>(v)); }
+    void PutU16(uint16_t v) { PutLE(v); }
+    void PutU32(uint32_t v) { PutLE(v); }
+    void PutF32(float v) {
+        uint32_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        PutLE(bits);
+    }
+    void PutF64(double v) {
+        uint64_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        PutLE(bits);
+    }
+    void PutVarint(uint64_t v) {
+        while (v >= 0x80) {
+            buf_.push_back(static_cast<char>((v & 0x7f) | 0x80));
+            v >>= 7;
+        }
+        buf_.push_back(static_cast<char>(v));
+    }
+    void PutString(std::string_view s) {
+        PutVarint(s.size());
+        buf_.append(s);
+    }
+    // Copies already encoded records.
+    void PutRaw(std::string_view bytes) { buf_.append(bytes); }
+
+    void Clear() { buf_.clear(); }
+    bool Empty() const { return buf_.empty(); }
+    inline const std::string &get_data() const { return buf_; }
+};
+
+inline void PutNameRecord(WireWriter &out, uint32_t index, std::string_view name) {
+    out.PutU8(static_cast<uint8_t>(WireRecord::NAME));
+    out.PutVarint(index);
+    out.PutString(name);
+}
+
+inline void PutStateRecord(WireWriter &out, WireMessage message, const WireState &state) {
+    out.PutU8(static_cast<uint8_t>(WireRecord::STATE));
+    out.PutU8(static_cast<uint8_t>(message));
+    out.PutVarint(state.index);
+    out.PutU8(state.flags);
+    out.PutF32(state.x);
+    out.PutF32(state.y);
+    out.PutF32(state.vx);
+    out.PutF32(state.vy);
+    out.PutF32(state.size);
+    out.PutU32(state.life_length);
+    out.PutU16(static_cast<uint16_t>(state.health));
+}
+
+// Clamps a life length in ms to the u32 field, WIRE_NO_EXPIRY at the top.
+inline uint32_t WireLifeLength(long long life_length) {
+    return static_cast<uint32_t>(std::clamp<long long>(life_length, 0, WIRE_NO_EXPIRY));
+}
+
+inline int16_t WireHealth(int health) {
+    return static_cast<int16_t>(std::clamp<int>(health, INT16_MIN, INT16_MAX));
+}
+
+inline void PutCellRecord(WireWriter &out, int row, int col) {
+    out.PutU8(static_cast<uint8_t>(WireRecord::CELL));
+    out.PutU32(static_cast<uint32_t>(row));
+    out.PutU32(static_cast<uint32_t>(col));
+}
+
+// Reads fields written by WireWriter. Reading past the end yields zeros
+// and clears Ok(), so callers check once after decoding a record.
+class WireReader {
+    std::string_view data_;
+    size_t pos_ = 0;
+    bool ok_ = true;
+
+    template <typename T>
+    T GetLE() {
+        if (data_.size() - pos_ < sizeof(T)) {
+            ok_ = false;
+            pos_ = data_.size();
+            return 0;
+        }
+        T v = 0;
+        for (size_t i = 0; i < sizeof(T); i++) v |= static_cast<T>(static_cast<uint8_t>(data_[pos_ + i])) << (8 * i);
+        pos_ += sizeof(T);
+        return v;
+    }
+
+public:
+    explicit WireReader(std::string_view data) : data_(data) {}
+
+    uint8_t GetU8() { return GetLE<uint8_t>(); }
+    uint16_t GetU16() { return GetLE<uint16_t>(); }
+    uint32_t GetU32() { return GetLE<uint32_t>(); }
+    float GetF32() {
+        uint32_t bits = GetLE<uint32_t>();
+        float v;
+        std::memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+    double GetF64() {
+        uint64_t bits = GetLE<uint64_t>();
+        double v;
+        std::memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+    uint64_t GetVarint() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t byte = GetU8();
+            v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return v;
+        }
+        ok_ = false;
+        return v;
+    }
+    std::string_view GetString() {
+        uint64_t size = GetVarint();
+        if (size > data_.size() - pos_) {
+            ok_ = false;
+            pos_ = data_.size();
+            return {};
+        }
+        std::string_view s = data_.substr(pos_, size);
+        pos_ += size;
+        return s;
+    }
+
+    bool Ok() const { return ok_; }
+    bool AtEnd() const { return pos_ >= data_.size(); }
+};
+
+#endif